@@ -1,4 +1,5 @@
 import sys
+import threading
 from PyQt5.QtWidgets import (
     QApplication, QMainWindow, QWidget, QVBoxLayout,
     QHBoxLayout, QPushButton, QLabel, QTextEdit, QLineEdit, QComboBox
@@ -18,6 +19,7 @@ from scipy.signal import firwin, freqz
 Commands:
   S<addr>$<value> - Set register (addr: 0-64, value: signed 16-bit)
   R<addr>         - Read register (addr: 0-64)
+  D               - Dump all registers as one "D:v0,v1,..." line
   T<interval>     - Set timer interval in ms (100-5000)
 
 Commands must be sent with enter
@@ -51,6 +53,150 @@ class SerialReaderThread(QThread):
         self.running = False
 
 
+class CoefficientWriterThread(QThread):
+    """Thread for writing coefficients with a sliding acknowledgment window.
+
+    Each S command is sent CRC-framed as "#<seq>:<cmd>*<crc8>" so the
+    firmware answers (or NAKs) every item individually. Up to
+    window_size commands are in flight at once, so the wire stays busy
+    instead of idling one round trip per register; only NAKed or
+    timed-out items are retransmitted. Once every tap is acknowledged a
+    framed C command commits the staged bank, which is what actually
+    swaps the new filter into hardware. Received serial text is fed in
+    from the GUI thread via feed() - the reader thread keeps sole
+    ownership of the port's read side.
+    """
+    progress = pyqtSignal(int, int)  # (acknowledged, total)
+    log = pyqtSignal(str)
+    finished_ok = pyqtSignal(bool)
+
+    WINDOW_SIZE = 8      # ~18 bytes per framed command, well inside the
+                         # firmware's 512-byte RX ring
+    ACK_TIMEOUT = 1.0    # Seconds before an unacknowledged item is resent
+    MAX_RETRIES = 3
+
+    def __init__(self, serial_port, values):
+        super().__init__()
+        self.serial_port = serial_port
+        self.values = list(values)
+        self.running = True
+        self.rx_buffer = ""
+        self.rx_tail = ""  # Unmatched leftover from previous polls
+        self.rx_lock = threading.Lock()
+
+    def feed(self, text):
+        """Hand received serial text to the worker (called from GUI thread)"""
+        with self.rx_lock:
+            self.rx_buffer += text
+
+    def stop(self):
+        """Stop the thread"""
+        self.running = False
+
+    @staticmethod
+    def crc8(data):
+        """CRC8, polynomial 0x07, init 0x00 - matches the firmware framing"""
+        crc = 0
+        for byte in data.encode('utf-8'):
+            crc ^= byte
+            for _ in range(8):
+                crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+        return crc
+
+    def frame(self, seq, cmd):
+        """Build one CRC-framed command line"""
+        body = f"{seq}:{cmd}"
+        return f"#{body}*{self.crc8(body):02X}\n"
+
+    def run(self):
+        total = len(self.values)
+        items = [(addr, f"S{addr}${int(val)}") for addr, val in enumerate(self.values)]
+
+        # Stage all taps first: S only writes the staged bank in RAM,
+        # the running filter is untouched until the commit below
+        if not self._transfer(items, 0, total + 1):
+            self.finished_ok.emit(False)
+            return
+
+        # Swap the whole bank into hardware atomically; only its ack
+        # means the new filter is actually live
+        self.log.emit("All coefficients staged, committing...")
+        self.finished_ok.emit(self._transfer([(total, "C")], total, total + 1))
+
+    def _transfer(self, items, done, total):
+        """Send items through the sliding ack window; True when all acked.
+
+        done/total feed the progress signal across both transfer phases.
+        """
+        import re
+        import time
+
+        count = len(items)
+        pending = list(items)
+        in_flight = {}  # seq -> (cmd, send_time, retries)
+        acked = 0
+        response_re = re.compile(r'#(\d+):([^*\r\n]*)\*([0-9A-Fa-f]{2})')
+
+        while self.running and acked < count:
+            # Fill the window
+            while pending and len(in_flight) < self.WINDOW_SIZE:
+                seq, cmd = pending.pop(0)
+                try:
+                    self.serial_port.write(self.frame(seq, cmd).encode('utf-8'))
+                except Exception as e:
+                    self.log.emit(f"Error sending {cmd}: {e}")
+                    return False
+                in_flight[seq] = (cmd, time.monotonic(), 0)
+
+            # Process responses accumulated by the reader thread. The
+            # unmatched tail is kept across polls - an ack routinely
+            # arrives split over two serial reads and must not be lost
+            with self.rx_lock:
+                self.rx_tail += self.rx_buffer
+                self.rx_buffer = ""
+            last_end = 0
+            for match in response_re.finditer(self.rx_tail):
+                last_end = match.end()
+                seq = int(match.group(1))
+                body = match.group(2)
+                if seq not in in_flight:
+                    continue
+                cmd, send_time, retries = in_flight.pop(seq)
+                if body == "NAK":
+                    # Corrupted on the wire - retransmit just this item
+                    self.log.emit(f"NAK for {cmd}, retransmitting")
+                    pending.insert(0, (seq, cmd))
+                else:
+                    acked += 1
+                    self.progress.emit(done + acked, total)
+            self.rx_tail = self.rx_tail[last_end:]
+            # A complete frame is well under 64 characters, so anything
+            # older in the tail is console noise, not a partial ack
+            if len(self.rx_tail) > 256:
+                self.rx_tail = self.rx_tail[-256:]
+
+            # Retransmit items that timed out
+            now = time.monotonic()
+            for seq in list(in_flight):
+                cmd, send_time, retries = in_flight[seq]
+                if now - send_time < self.ACK_TIMEOUT:
+                    continue
+                if retries >= self.MAX_RETRIES:
+                    self.log.emit(f"Error: no acknowledgment for {cmd} "
+                                  f"after {self.MAX_RETRIES} retries, aborting")
+                    return False
+                try:
+                    self.serial_port.write(self.frame(seq, cmd).encode('utf-8'))
+                except Exception as e:
+                    self.log.emit(f"Error resending {cmd}: {e}")
+                    return False
+                in_flight[seq] = (cmd, now, retries + 1)
+
+            self.msleep(10)
+
+        return acked == count
+
+
 class BasicQtApp(QMainWindow):
     def __init__(self):
         super().__init__()
@@ -64,6 +210,9 @@ class BasicQtApp(QMainWindow):
         self.response_timeout_timer = None  # Timer for response timeout
         self.max_retries = 3  # Maximum retry attempts per address
         self.retry_count = 0  # Current retry count
+        self.bulk_read_mode = False  # Waiting for a D (bulk dump) response
+        self.bulk_read_timer = None  # Timeout timer for the bulk dump
+        self.writer_thread = None  # Background coefficient writer
         self.init_ui()
 
     def init_ui(self):
@@ -247,9 +396,19 @@ class BasicQtApp(QMainWindow):
 
             # Stop any active reading operations
             self.reading_mode = False
+            self.bulk_read_mode = False
             if self.response_timeout_timer:
                 self.response_timeout_timer.stop()
                 self.response_timeout_timer = None
+            if self.bulk_read_timer:
+                self.bulk_read_timer.stop()
+                self.bulk_read_timer = None
+
+            # Stop writer thread
+            if self.writer_thread:
+                self.writer_thread.stop()
+                self.writer_thread.wait()
+                self.writer_thread = None
 
             # Stop reader thread
             if self.reader_thread:
@@ -269,6 +428,16 @@ class BasicQtApp(QMainWindow):
         """Handle data received from serial port"""
         self.console.append(text)
 
+        # Forward framed acknowledgments to an active coefficient writer
+        if self.writer_thread and self.writer_thread.isRunning():
+            self.writer_thread.feed(text)
+
+        # Parse bulk dump response if waiting for one
+        if self.bulk_read_mode:
+            self.response_buffer += text
+            self.parse_bulk_response()
+            return
+
         # Parse read responses if in reading mode
         if self.reading_mode and self.waiting_for_response:
             # Accumulate text in response buffer
@@ -276,13 +445,67 @@ class BasicQtApp(QMainWindow):
             self.parse_read_response()
 
     def on_read_clicked(self):
-        """Handle read button click"""
-        self.log_to_console("Reading from all 64 addresses...")
-
+        """Handle read button click: request all registers with one D command"""
         if not self.serial_port or not self.serial_port.is_open:
             self.log_to_console("Error: Serial port not open. Please connect first.")
             return
 
+        self.log_to_console("Reading all registers (bulk dump)...")
+
+        # One round trip for the whole register file instead of one per
+        # register - the firmware answers with a single "D:v0,v1,..." line
+        self.read_values = []
+        self.bulk_read_mode = True
+        self.response_buffer = ""
+
+        try:
+            self.serial_port.write("D\n".encode('utf-8'))
+            self.log_to_console("> D")
+        except Exception as e:
+            self.log_to_console(f"Error sending dump command: {str(e)}")
+            self.bulk_read_mode = False
+            return
+
+        # Fall back to the per-register path if the dump never arrives
+        # (e.g. older firmware without the D command)
+        if self.bulk_read_timer:
+            self.bulk_read_timer.stop()
+        self.bulk_read_timer = QTimer()
+        self.bulk_read_timer.setSingleShot(True)
+        self.bulk_read_timer.timeout.connect(self.handle_bulk_read_timeout)
+        self.bulk_read_timer.start(2000)
+
+    def parse_bulk_response(self):
+        """Parse the single-line bulk dump response"""
+        import re
+
+        # Complete "D:v0,v1,..." line (the firmware echo of the command
+        # itself has no ':', so it cannot match)
+        match = re.search(r'D:(-?\d+(?:,-?\d+)+)[\r\n]', self.response_buffer)
+        if not match:
+            return
+
+        if self.bulk_read_timer:
+            self.bulk_read_timer.stop()
+        self.bulk_read_mode = False
+
+        # One numpy pass over the whole payload
+        values = np.array(match.group(1).split(','), dtype=int)
+        self.read_values = values.tolist()
+
+        self.log_to_console(f"Bulk dump received ({len(values)} values)")
+        self.plot_read_values()
+
+    def handle_bulk_read_timeout(self):
+        """Bulk dump timed out - fall back to per-register reads"""
+        if not self.bulk_read_mode:
+            return
+        self.bulk_read_mode = False
+        self.log_to_console("Bulk dump timed out, falling back to per-register reads...")
+        self.start_legacy_read()
+
+    def start_legacy_read(self):
+        """Read all registers one R command at a time (legacy path)"""
         # Clear previous values and start reading
         self.read_values = []
         self.current_address = 0
@@ -426,11 +649,19 @@ class BasicQtApp(QMainWindow):
         """Handle window close event"""
         # Stop any active reading operations
         self.reading_mode = False
+        self.bulk_read_mode = False
         if self.response_timeout_timer:
             self.response_timeout_timer.stop()
             self.response_timeout_timer = None
+        if self.bulk_read_timer:
+            self.bulk_read_timer.stop()
+            self.bulk_read_timer = None
 
         # Clean up serial connection
+        if self.writer_thread:
+            self.writer_thread.stop()
+            self.writer_thread.wait()
+
         if self.reader_thread:
             self.reader_thread.stop()
             self.reader_thread.wait()
@@ -501,18 +732,31 @@ class BasicQtApp(QMainWindow):
         fixed = np.round(coeff * scale)
         fixed = np.clip(fixed, -32768, 32767).astype(np.int16)
 
-        self.log_to_console("Writing computed FIR coefficients...")
+        if self.writer_thread and self.writer_thread.isRunning():
+            self.log_to_console("Error: a coefficient write is already in progress.")
+            return
 
-        for addr, val in enumerate(fixed):
-            cmd = f"S{addr}${int(val)}"
-            try:
-                self.serial_port.write((cmd + "\n").encode())
-                self.log_to_console(f"> {cmd}")
-            except Exception as e:
-                self.log_to_console(f"Error sending {cmd}: {e}")
-                break
+        self.log_to_console("Writing computed FIR coefficients...")
 
-        self.log_to_console("Done writing coefficients.")
+        # The write runs in a worker thread with a sliding ack window, so
+        # the GUI stays responsive and only NAKed items are resent
+        self.writer_thread = CoefficientWriterThread(self.serial_port, fixed)
+        self.writer_thread.progress.connect(self.on_write_progress)
+        self.writer_thread.log.connect(self.log_to_console)
+        self.writer_thread.finished_ok.connect(self.on_write_finished)
+        self.writer_thread.start()
+
+    def on_write_progress(self, acked, total):
+        """Report coefficient write progress without flooding the console"""
+        if acked % 16 == 0 or acked == total:
+            self.log_to_console(f"Write progress: {acked}/{total}")
+
+    def on_write_finished(self, ok):
+        """Coefficient writer thread finished"""
+        if ok:
+            self.log_to_console("Done writing coefficients.")
+        else:
+            self.log_to_console("Coefficient write failed.")
 
         
         
@@ -7,14 +7,14 @@
  * ===== COMMUNICATION ARCHITECTURE =====
  * 1. RS232 UART (uart_0) - USER INTERFACE
  *    - Purpose: Interactive command console for user
- *    - Config: 115200 baud, 8N1, no flow control
+ *    - Config: 115200 baud, 8N1, XON/XOFF software flow control
  *    - Features:
- *      * Interrupt-driven RX (command input)
+ *      * Interrupt-driven RX with 512 byte circular buffer (lossless command input)
  *      * Buffered TX with interrupt-driven transmission (512 byte circular buffer)
  *      * Error detection (parity, frame, overrun)
  *      * Non-blocking buffered output
  *      * Automatic CRLF conversion (LF -> CRLF) for terminal compatibility
- *    - Functions: uart_putchar(), uart_puts(), uart_put_int(), uart_flush()
+ *    - Functions: uart_write(), uart_putchar(), uart_puts(), uart_put_int(), uart_flush()
  *    - Pin connection: Connect to RS232 transceiver GPIO pins
  *
  * 2. JTAG UART (jtag_uart_0) - DEBUG CHANNEL
@@ -30,13 +30,65 @@
  * - UART error monitoring and reporting
  *
  * ===== COMMANDS (via RS232 UART) =====
- * S<addr>$<value> - Set FIR register at address (0-64) with signed 16-bit value
- * R<addr>         - Read FIR register at address (0-64)
+ * S<addr>$<value> - Stage FIR register at address (0-64) with signed 16-bit value
+ * W<start>$<v0>,<v1>,... - Stage signed 16-bit values for consecutive registers
+ * F<type>$<fc>[,<fc2>] - Synthesize a filter on-target and commit it
+ *                   (windowed sinc, Hamming, 48 kHz, 64 taps, lp/hp/bp/bs)
+ * C               - Commit the staged coefficient bank to hardware atomically
+ * L[<idx>[!|=<name>]] - Preset store: list / load / save / rename slots
+ * M<slot>{ ... }  - Record the following lines into macro slot (0-3);
+ *                   '}' on its own line ends the recording
+ * M<slot>!        - Replay a macro at internal dispatch speed (one
+ *                   summary response); M alone lists the slots
+ * R<addr>         - Read FIR register at address (0-64) from the RAM shadow
+ * R!<addr>        - Read FIR register via the Avalon bus (verification)
+ * D               - Dump all 65 registers as one compact line (RAM shadow)
+ * V               - CRC16 (CCITT) over all 65 registers for upload verification
+ * A[<n>]          - Capture n FIR in/out sample pairs (max 256) and stream
+ *                   them over JTAG in the background ("CAP:<in>,<out>" lines)
+ * N[<addr>|E|!]   - Watch mode: subscribe to register addresses (NE = error
+ *                   counters, N! = clear); changes push "N:<addr>=<value>"
+ * P               - Print ISR/main-loop profiling stats (cycles) and reset
+ * X               - Run on-target micro-benchmarks (bus, TX ring, wire)
+ * I               - Print continuous performance counters
+ * B<baud>         - Set UART baud rate (9600-921600, 3s fallback to 115200)
+ * J<level>        - Set runtime JTAG log level (0=off 1=error 2=info 3=trace)
  * T<interval>     - Set PIO timer interval in ms (100-5000)
+ * ESC B           - Switch console to binary command mode (see below)
+ *
+ * ===== BINARY COMMAND MODE =====
+ * For automated hosts the ASCII protocol is too chatty (~12 bytes plus echo
+ * per register). Sending ESC 'B' switches the console into a length-prefixed
+ * binary framing with no echo:
+ *
+ *   <len> <opcode> <payload...>
+ *
+ *   len    - number of bytes following (opcode + payload)
+ *   opcode - 0x01 SET:    payload = addr, value_lo, value_hi (little endian)
+ *            0x02 GET:    payload = addr, response = value_lo value_hi
+ *            0x03 COMMIT: no payload, commit the staged coefficient bank
+ *            0x00 EXIT:   no payload, return to ASCII mode
+ *
+ * SET frames are acknowledged with ACK (0x06), malformed frames with NAK
+ * (0x15), so a full 64-coefficient upload is 64 * 5 bytes on the wire.
+ * ASCII mode remains the default after reset.
+ *
+ * ===== CRC-FRAMED COMMAND VARIANT =====
+ * Any ASCII command can also be sent as
+ *
+ *   #<seq>:<command>*<crc8>
+ *
+ * where <seq> is a decimal sequence number (0-255) and <crc8> is two hex
+ * digits of CRC8 (poly 0x07, init 0x00) over "<seq>:<command>". The
+ * response comes back in the same framing with the same sequence number;
+ * a corrupted or malformed frame is answered with "#<seq>:NAK*<crc8>"
+ * immediately, so the host retransmits within milliseconds instead of
+ * waiting out a timeout. Framed lines are not echoed.
  *
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include "system.h"
 #include "sys/alt_irq.h"
@@ -68,32 +120,373 @@ const int16_t fir_coefficients[64] = {
     0x0000, 0x0000   
 };
 
+// ========== DOUBLE-BUFFERED COEFFICIENT BANK ==========
+// Set/write commands no longer touch the MM bridge directly: they land
+// in this staged bank in RAM, and the 'C' command copies all 65 values
+// to the hardware in one tight back-to-back loop. The filter therefore
+// never runs with a half-old/half-new tap set for the duration of an
+// upload - the inconsistency window shrinks from the upload time
+// (seconds at 115200 baud) to the microseconds of the commit loop, and
+// an aborted upload simply never gets committed.
+#define COEFF_REG_COUNT 65
+int16_t coeff_staged[COEFF_REG_COUNT];
+
+// Shadow of the values last committed to hardware. The Nios is the only
+// writer of the register file, so reads can be served from RAM instead
+// of crossing the Avalon fabric - R and D use this, making readback
+// limited purely by UART bandwidth. R!<addr> still reads the bus for
+// verification.
+int16_t coeff_shadow[COEFF_REG_COUNT];
+
+// Stage one value; takes effect on the next commit
+void coeff_stage(int addr, int16_t value)
+{
+	coeff_staged[addr] = value;
+}
+
+// Burst block-copy into the bridge aperture, starting at register 0.
+// IOWR_32DIRECT re-derives the bypassed address from base and offset on
+// every call; over a 65-word commit that address arithmetic costs about
+// as much as the stores themselves on the Nios II/e. This walks a
+// single volatile pointer instead - pre-biased with
+// ALT_CPU_DCACHE_BYPASS_MASK, the same bypass the IOWR macros apply -
+// and unrolls four stores deep so the writes issue back-to-back,
+// shrinking the live-swap window of a commit to the bare store
+// sequence.
+void fir_write_block(const int16_t *src, int count)
+{
+	volatile uint32_t *dst = (volatile uint32_t *)
+		((uint32_t)MM_BRIDGE_0_BASE | ALT_CPU_DCACHE_BYPASS_MASK);
+
+	while (count >= 4)
+	{
+		dst[0] = (uint32_t)src[0];
+		dst[1] = (uint32_t)src[1];
+		dst[2] = (uint32_t)src[2];
+		dst[3] = (uint32_t)src[3];
+		dst += 4;
+		src += 4;
+		count -= 4;
+	}
+	while (count-- > 0)
+	{
+		*dst++ = (uint32_t)*src++;
+	}
+}
+
+// Copy the whole staged bank to the MM bridge back-to-back
+void coeff_commit(void)
+{
+	fir_write_block(coeff_staged, COEFF_REG_COUNT);
+
+	// Track what the hardware now holds
+	memcpy(coeff_shadow, coeff_staged, sizeof(coeff_shadow));
+}
+
+// ========== COEFFICIENT PRESET STORE ==========
+// The deployment cycles between a handful of known filters (500 Hz LP,
+// 2 kHz LP, 3 kHz LP, ...). Instead of re-uploading 64 taps over the
+// wire each time, a few named banks live in on-chip RAM and can be
+// loaded straight into the MM bridge with a two-byte command:
+//   L          - list slots
+//   L<idx>     - load slot into the staged bank and commit it
+//   L<idx>!    - save the current staged bank into the slot
+//   L<idx>=<name> - rename the slot
+// Slot 0 is filled with the built-in 500 Hz Blackman LPF at boot.
+#define PRESET_COUNT 4
+#define PRESET_NAME_LEN 12
+int16_t preset_store[PRESET_COUNT][64];
+char preset_names[PRESET_COUNT][PRESET_NAME_LEN];
+
+// Copy a preset into the staged bank and commit it to hardware
+void preset_load(int idx)
+{
+	memcpy(coeff_staged, preset_store[idx], sizeof(preset_store[idx]));
+	coeff_commit();
+}
+
+// Snapshot the current staged bank (taps 0-63) into a preset slot
+void preset_save(int idx)
+{
+	memcpy(preset_store[idx], coeff_staged, sizeof(preset_store[idx]));
+}
+
+// ========== CYCLE-ACCURATE PROFILING ==========
+// Timestamp capture around each ISR body and the main loop, based on
+// snapshot reads of the 1 ms periodic timer (120000 cycles per period
+// at 120 MHz). Durations are derived from the down-counting snapshot
+// with single-wrap correction, so anything longer than one timer period
+// is folded modulo 1 ms - fine for the sub-millisecond handlers being
+// measured. The 'P' command prints min/max/mean cycles per scope and
+// resets the statistics.
+#define PROF_TIMER_PERIOD (TIMER_0_LOAD_VALUE + 1)
+
+typedef struct
+{
+	uint32_t count; // Number of recorded intervals
+	uint32_t min;   // Shortest interval in cycles
+	uint32_t max;   // Longest interval in cycles
+	uint32_t total; // Sum of all intervals (for the mean)
+} prof_stat_t;
+
+volatile prof_stat_t prof_uart_isr;
+volatile prof_stat_t prof_jtag_isr;
+volatile prof_stat_t prof_main_loop;
+
+// Latch and read the current timer count (down counter, cycles)
+static uint32_t prof_snapshot(void)
+{
+	// Writing SNAPL latches the full count into the snapshot registers
+	IOWR_ALTERA_AVALON_TIMER_SNAPL(TIMER_0_BASE, 0);
+	return (uint32_t)IORD_ALTERA_AVALON_TIMER_SNAPL(TIMER_0_BASE) |
+	       ((uint32_t)IORD_ALTERA_AVALON_TIMER_SNAPH(TIMER_0_BASE) << 16);
+}
+
+// Main-context variant: the snapshot latch is one shared hardware
+// register, and the ISR profiling brackets re-latch it. An interrupt
+// between the latch write above and the two reads would combine SNAPL
+// and SNAPH from different latches - a +/-65536-cycle tear. Close the
+// window by latching and reading with interrupts held off. ISRs keep
+// using prof_snapshot() directly; they cannot be preempted.
+static uint32_t prof_snapshot_atomic(void)
+{
+	alt_irq_context irq_context = alt_irq_disable_all();
+	uint32_t snap = prof_snapshot();
+
+	alt_irq_enable_all(irq_context);
+	return snap;
+}
+
+// Cycles elapsed between two snapshots of the down counter
+static uint32_t prof_elapsed(uint32_t start_snap, uint32_t end_snap)
+{
+	if (start_snap >= end_snap)
+	{
+		return start_snap - end_snap;
+	}
+	// The counter reloaded in between
+	return start_snap + PROF_TIMER_PERIOD - end_snap;
+}
+
+// Fold one measured interval into a statistics slot
+static void prof_record(volatile prof_stat_t *s, uint32_t cycles)
+{
+	if (s->count == 0 || cycles < s->min)
+	{
+		s->min = cycles;
+	}
+	if (cycles > s->max)
+	{
+		s->max = cycles;
+	}
+	s->total += cycles;
+	s->count++;
+}
+
+// Clear all statistics (done by the P command after printing)
+static void prof_reset(void)
+{
+	memset((void *)&prof_uart_isr, 0, sizeof(prof_uart_isr));
+	memset((void *)&prof_jtag_isr, 0, sizeof(prof_jtag_isr));
+	memset((void *)&prof_main_loop, 0, sizeof(prof_main_loop));
+}
+
+// ========== RUNTIME BAUD-RATE RECONFIGURATION ==========
+// The host GUI already offers up to 921600 baud; the firmware divisor
+// was the bottleneck. B<baud> reprograms the UART divisor from
+// ALT_CPU_FREQ (120 MHz). After switching away from the default rate
+// the firmware is "on probation": if the host does not send any
+// character within the fallback timeout it reverts to 115200, so a
+// failed switch can not lock the console out permanently.
+#define UART_DEFAULT_BAUD 115200
+#define UART_MIN_BAUD 9600
+#define UART_MAX_BAUD 921600
+#define BAUD_FALLBACK_TIMEOUT_MS 3000
+
+uint32_t uart_current_baud = UART_DEFAULT_BAUD;
+// Nonzero while waiting for the host to confirm the new rate
+uint8_t baud_probation = 0;
+uint32_t baud_probation_start = 0; // uptime_ms when the switch happened
+
 // Global variables for interrupt handling
 volatile uint32_t timer_tick_count = 0;
-volatile uint8_t uart_rx_flag = 0;
-volatile char uart_rx_char = 0;
+// Free-running millisecond counter (never reset, unlike timer_tick_count
+// which the PIO toggle pacing clears)
+volatile uint32_t uptime_ms = 0;
+
+// RX circular buffer for interrupt-driven reception
+// Symmetric to the TX buffer below: the ISR writes at rx_head, the main
+// loop reads at rx_tail. A single latched byte (the old uart_rx_char)
+// lost characters whenever two bytes arrived while the main loop was busy.
+#define RX_BUFFER_SIZE 512
+volatile char rx_buffer[RX_BUFFER_SIZE];
+volatile uint16_t rx_head = 0;
+volatile uint16_t rx_tail = 0;
 
 // TX circular buffer for interrupt-driven transmission
 // Size can be increased for better burst handling (256, 512, 1024, 2048, etc.)
 // Larger buffer = more RAM usage but better handling of output bursts
 #define TX_BUFFER_SIZE 512
+
+// Buffer sizes MUST be powers of two: index wraparound uses these masks
+// instead of '%' because this CPU has no hardware divider
+// (ALT_CPU_HARDWARE_DIVIDE_PRESENT 0 in system.h) and each modulo would
+// be a software-division library call inside the ISR
+#define RX_BUFFER_MASK (RX_BUFFER_SIZE - 1)
+#define TX_BUFFER_MASK (TX_BUFFER_SIZE - 1)
 volatile char tx_buffer[TX_BUFFER_SIZE];
 volatile uint16_t tx_head = 0;
 volatile uint16_t tx_tail = 0;
 
+// ========== XON/XOFF SOFTWARE FLOW CONTROL ==========
+// Needed to run reliably above 115200: when the RX ring nears capacity
+// we send XOFF (jumping ahead of queued TX data) and XON once the main
+// loop has drained it; conversely an XOFF from the host pauses draining
+// of the TX ring. Interception is suspended in binary command mode,
+// where 0x11/0x13 are legitimate payload bytes.
+#define XON_CHAR 0x11
+#define XOFF_CHAR 0x13
+// Send XOFF at 3/4 full, XON again below 1/4
+#define RX_XOFF_THRESHOLD (3 * RX_BUFFER_SIZE / 4)
+#define RX_XON_THRESHOLD (RX_BUFFER_SIZE / 4)
+
+volatile uint8_t tx_paused = 0;       // Host sent XOFF - hold TX ring draining
+volatile uint8_t rx_flow_stopped = 0; // We sent XOFF - host should be silent
+volatile char flow_pending = 0;       // XON/XOFF waiting to jump the TX queue
+
+// Defined in the console section; flow control must know the mode
+static uint8_t binary_mode;
+
+// Defined in the framed-console section; uart_write redirects output
+// into the response buffer while a framed command executes, so the
+// response can be sent as one CRC-protected frame
+#define FRAME_RESP_MAX 512
+static uint8_t frame_capture;
+static char frame_resp[FRAME_RESP_MAX];
+static uint16_t frame_resp_len;
+
 // UART error counters for diagnostics
 volatile uint32_t uart_parity_errors = 0;
 volatile uint32_t uart_frame_errors = 0;
 volatile uint32_t uart_overrun_errors = 0;
+// Bytes discarded because the RX ring was full (software-side overrun)
+volatile uint32_t uart_rx_dropped = 0;
+
+// ========== PERFORMANCE COUNTERS ==========
+// Continuous counters (never reset at runtime) complementing the error
+// counters above. The 'I' command prints them all; a few also appear in
+// the periodic JTAG debug dump. The TX high-water mark is the data that
+// lets TX_BUFFER_SIZE be sized from measurement instead of guesswork.
+volatile uint32_t stat_uart_isr_count = 0;  // UART ISR invocations
+volatile uint32_t stat_jtag_isr_count = 0;  // JTAG UART ISR invocations
+volatile uint32_t stat_rx_bytes = 0;        // Bytes accepted into the RX ring
+volatile uint32_t stat_tx_bytes = 0;        // Bytes sent out of the TX ring
+volatile uint32_t stat_tx_rejected = 0;     // Bytes refused by a full TX ring
+volatile uint32_t stat_tx_high_water = 0;   // Max TX ring fill level seen
+volatile uint32_t stat_commands = 0;        // Console commands executed
+
+// ========== EVENT FLAGS FOR THE IDLE MAIN LOOP ==========
+// Nios II/e has no sleep/wait-for-interrupt instruction, so the closest
+// idle primitive is a tight poll of a single event word that only the
+// ISRs write. The main loop does nothing at all until an ISR posts an
+// event here, then wakes straight into the handler for it - command
+// latency no longer depends on where in a print the loop happened to be
+// when a byte arrived.
+#define EVENT_RX   0x01 // Byte placed in the RX ring (RS232 or JTAG)
+#define EVENT_TICK 0x02 // Timer tick elapsed
+
+volatile uint8_t event_pending = 0;
+
+// ========== POLLED MILLISECOND TIMEBASE ==========
+// The timer used to interrupt 1000 times per second solely to increment
+// timer_tick_count - a thousand ISR entries per second of pure overhead
+// stealing cycles from UART handling. The timer (fixed 1 ms period in
+// Qsys, always running) now runs with its interrupt disabled and the
+// millisecond counters advance in timebase_poll(), which folds the
+// cycles elapsed since the previous poll into an accumulator. The idle
+// loop and every blocking wait call it, so it runs far more often than
+// once per timer period - the only requirement for not losing time.
+// Code that blocks longer than 1 ms without polling would fold the
+// excess modulo one period.
+static uint32_t timebase_last_snap = 0;
+static uint32_t timebase_cycle_acc = 0;
+
+void timebase_poll(void)
+{
+	uint32_t snap = prof_snapshot_atomic();
+
+	timebase_cycle_acc += prof_elapsed(timebase_last_snap, snap);
+	timebase_last_snap = snap;
+
+	// Convert whole milliseconds out of the cycle accumulator
+	int ticked = 0;
+
+	while (timebase_cycle_acc >= PROF_TIMER_PERIOD)
+	{
+		timebase_cycle_acc -= PROF_TIMER_PERIOD;
+		timer_tick_count++;
+		uptime_ms++;
+		ticked = 1;
+	}
+
+	// event_pending is also |='d from the UART/JTAG ISRs; a plain
+	// read-modify-write here can lose an EVENT_RX that lands between
+	// the load and the store, so mask interrupts around the update
+	if (ticked)
+	{
+		alt_irq_context irq_context = alt_irq_disable_all();
+
+		event_pending |= EVENT_TICK;
+		alt_irq_enable_all(irq_context);
+	}
+}
+
+// Store one received byte in the RX ring (ISR context only)
+// If the ring is full the byte is dropped and counted - the alternative
+// (overwriting the oldest byte) would corrupt a command mid-line
+static void rx_buffer_put(char c)
+{
+	uint16_t next_head = (rx_head + 1) & RX_BUFFER_MASK;
+
+	if (next_head == rx_tail)
+	{
+		uart_rx_dropped++;
+		return;
+	}
+
+	rx_buffer[rx_head] = c;
+	rx_head = next_head;
+	stat_rx_bytes++;
+	event_pending |= EVENT_RX;
+}
+
+// Check whether the RX ring holds unread bytes (main-loop side)
+int uart_rx_available(void)
+{
+	return rx_head != rx_tail;
+}
 
-// Timer Interrupt Service Routine
-static void timer_isr(void *context)
+// Fetch the next received byte - call only when uart_rx_available()
+char uart_rx_getchar(void)
 {
-	// Clear the interrupt by reading the status register
-	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER_0_BASE, 0);
+	char c = rx_buffer[rx_tail];
+	rx_tail = (rx_tail + 1) & RX_BUFFER_MASK;
+
+	// Ring drained below the low-water mark after an XOFF - let the
+	// host resume. The TX interrupt pushes the XON out.
+	if (rx_flow_stopped &&
+	    ((rx_head - rx_tail) & RX_BUFFER_MASK) < RX_XON_THRESHOLD)
+	{
+		uint32_t control;
+
+		rx_flow_stopped = 0;
+		flow_pending = XON_CHAR;
+		control = IORD_ALTERA_AVALON_UART_CONTROL(UART_0_BASE);
+		control |= ALTERA_AVALON_UART_CONTROL_TRDY_MSK;
+		IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, control);
+	}
 
-	// Increment tick counter
-	timer_tick_count++;
+	return c;
 }
 
 // RS232 UART Interrupt Service Routine (RX + TX + Error Handling)
@@ -101,6 +494,9 @@ static void uart_isr(void *context)
 {
 	uint32_t status;
 	uint32_t control;
+	uint32_t prof_start = prof_snapshot();
+
+	stat_uart_isr_count++;
 
 	// Read the status register
 	status = IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE);
@@ -133,36 +529,94 @@ static void uart_isr(void *context)
 	// Check if receive data is ready (RRDY bit)
 	if (status & ALTERA_AVALON_UART_STATUS_RRDY_MSK)
 	{
-		// Read the received character from RXDATA register
-		uart_rx_char = (char)IORD_ALTERA_AVALON_UART_RXDATA(UART_0_BASE);
-		uart_rx_flag = 1;
+		char ch = (char)IORD_ALTERA_AVALON_UART_RXDATA(UART_0_BASE);
+
+		// Intercept flow-control characters from the host (ASCII mode
+		// only - in binary mode these are legitimate payload bytes)
+		if (ch == XOFF_CHAR && !binary_mode)
+		{
+			tx_paused = 1;
+		}
+		else if (ch == XON_CHAR && !binary_mode)
+		{
+			tx_paused = 0;
+		}
+		else
+		{
+			rx_buffer_put(ch);
+
+			// Ring filling up - ask the host to stop sending
+			if (!rx_flow_stopped &&
+			    ((rx_head - rx_tail) & RX_BUFFER_MASK) >= RX_XOFF_THRESHOLD)
+			{
+				rx_flow_stopped = 1;
+				flow_pending = XOFF_CHAR;
+			}
+		}
 	}
 
 	// ===== TRANSMIT HANDLING (Interrupt-driven) =====
-	// Check if transmitter is ready and we have data to send
-	if ((status & ALTERA_AVALON_UART_STATUS_TRDY_MSK) && (tx_tail != tx_head))
+	// Keep feeding the transmitter for as long as TRDY stays asserted,
+	// instead of one byte per interrupt entry. Right after a write the
+	// holding register drains into the idle shift register within a few
+	// cycles, so one ISR entry typically moves two bytes and the next
+	// interrupt is a full character time away - halving the interrupt
+	// count during large bursts like the startup banner.
+	// A pending XON/XOFF jumps ahead of all queued data
+	if (flow_pending && (status & ALTERA_AVALON_UART_STATUS_TRDY_MSK))
 	{
-		// Send next character from buffer
-		IOWR_ALTERA_AVALON_UART_TXDATA(UART_0_BASE, tx_buffer[tx_tail]);
-		tx_tail = (tx_tail + 1) % TX_BUFFER_SIZE;
+		IOWR_ALTERA_AVALON_UART_TXDATA(UART_0_BASE, flow_pending);
+		flow_pending = 0;
+		status = IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE);
+	}
 
-		// If buffer is now empty, disable TX interrupt
-		if (tx_tail == tx_head)
+	if ((status & ALTERA_AVALON_UART_STATUS_TRDY_MSK) &&
+	    (tx_tail != tx_head) && !tx_paused)
+	{
+		do
 		{
-			control = IORD_ALTERA_AVALON_UART_CONTROL(UART_0_BASE);
-			control &= ~ALTERA_AVALON_UART_CONTROL_TRDY_MSK; // Disable TX interrupt
-			IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, control);
-		}
+			IOWR_ALTERA_AVALON_UART_TXDATA(UART_0_BASE, tx_buffer[tx_tail]);
+			tx_tail = (tx_tail + 1) & TX_BUFFER_MASK;
+			stat_tx_bytes++;
+
+			if (tx_tail == tx_head)
+			{
+				break;
+			}
+
+			// Re-read status once per byte sent - TRDY may already be
+			// back if the shift register picked up the previous byte
+			status = IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE);
+		} while (status & ALTERA_AVALON_UART_STATUS_TRDY_MSK);
+	}
+
+	// Keep the TX interrupt enabled only while there is something we
+	// are allowed to send - in particular, turn it off when the host
+	// has XOFFed us, or it would fire continuously doing nothing
+	control = IORD_ALTERA_AVALON_UART_CONTROL(UART_0_BASE);
+	if (flow_pending || (!tx_paused && tx_tail != tx_head))
+	{
+		control |= ALTERA_AVALON_UART_CONTROL_TRDY_MSK;
+	}
+	else
+	{
+		control &= ~ALTERA_AVALON_UART_CONTROL_TRDY_MSK;
 	}
+	IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, control);
 
 	// Clear interrupt status
 	IOWR_ALTERA_AVALON_UART_STATUS(UART_0_BASE, 0);
+
+	prof_record(&prof_uart_isr, prof_elapsed(prof_start, prof_snapshot()));
 }
 
 // JTAG UART Interrupt Service Routine
 static void jtag_uart_isr(void *context)
 {
 	uint32_t data;
+	uint32_t prof_start = prof_snapshot();
+
+	stat_jtag_isr_count++;
 
 	// Read the data register
 	data = IORD_ALTERA_AVALON_JTAG_UART_DATA(JTAG_UART_0_BASE);
@@ -170,43 +624,97 @@ static void jtag_uart_isr(void *context)
 	// Check if read data is valid (bit 15)
 	if (data & 0x8000)
 	{
-		uart_rx_char = (char)(data & 0xFF);
-		uart_rx_flag = 1;
+		// Feed JTAG input into the same RX ring as the RS232 console
+		rx_buffer_put((char)(data & 0xFF));
 	}
 
 	// Clear interrupt by reading control register and writing back
 	uint32_t control = IORD_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_0_BASE);
 	IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_0_BASE, control);
+
+	prof_record(&prof_jtag_isr, prof_elapsed(prof_start, prof_snapshot()));
 }
 
 // ========== RS232 UART OUTPUT FUNCTIONS (User Interface) ==========
-// Interrupt-driven buffered UART output - queues character for transmission
-// Returns 1 if character was queued, 0 if buffer is full
-int uart_putchar(char c)
+// Queue a block of bytes into the TX ring - the workhorse behind all
+// console output. Copies in at most two memcpy segments (up to the end
+// of the ring, then from its start) and touches the UART control
+// register exactly once, instead of one read-modify-write per character.
+// Returns the number of bytes accepted (less than len if the ring is
+// nearly full).
+uint16_t uart_write(const char *buf, uint16_t len)
 {
-	uint16_t next_head;
 	uint32_t control;
+	uint16_t free_space;
+	uint16_t head;
+	uint16_t first;
+
+	// While a CRC-framed command executes, its response is collected
+	// here instead of going on the wire, so it can be sent as one frame
+	// (see the framed-console section)
+	if (frame_capture)
+	{
+		uint16_t i;
 
-	// Calculate next head position
-	next_head = (tx_head + 1) % TX_BUFFER_SIZE;
+		for (i = 0; i < len && frame_resp_len < FRAME_RESP_MAX; i++)
+		{
+			frame_resp[frame_resp_len++] = buf[i];
+		}
+		return len;
+	}
 
-	// Check if buffer is full
-	if (next_head == tx_tail)
+	// Free slots in the ring - one slot stays empty so that
+	// head == tail always means "empty", not "full"
+	free_space = (uint16_t)((tx_tail - tx_head - 1) & TX_BUFFER_MASK);
+	if (len > free_space)
+	{
+		stat_tx_rejected += len - free_space;
+		len = free_space;
+	}
+	if (len == 0)
 	{
-		// Buffer full - could implement blocking wait here if needed
 		return 0;
 	}
 
-	// Add character to buffer
-	tx_buffer[tx_head] = c;
-	tx_head = next_head;
+	// First segment: from head up to the physical end of the buffer
+	head = tx_head;
+	first = TX_BUFFER_SIZE - head;
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy((void *)&tx_buffer[head], buf, first);
+
+	// Second segment: wraparound to the start of the buffer
+	if (len > first)
+	{
+		memcpy((void *)&tx_buffer[0], buf + first, len - first);
+	}
+
+	// Publish the new head only after the data is in place - the ISR
+	// reads tx_head and must never see unwritten slots
+	tx_head = (head + len) & TX_BUFFER_MASK;
+
+	// Track the highest fill level for TX_BUFFER_SIZE sizing decisions
+	first = (uint16_t)((tx_head - tx_tail) & TX_BUFFER_MASK);
+	if (first > stat_tx_high_water)
+	{
+		stat_tx_high_water = first;
+	}
 
-	// Enable TX interrupt to start transmission
+	// Enable TX interrupt to start transmission (single register touch)
 	control = IORD_ALTERA_AVALON_UART_CONTROL(UART_0_BASE);
 	control |= ALTERA_AVALON_UART_CONTROL_TRDY_MSK; // Enable TX interrupt
 	IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, control);
 
-	return 1; // Character queued successfully
+	return len;
+}
+
+// Interrupt-driven buffered UART output - queues character for transmission
+// Returns 1 if character was queued, 0 if buffer is full
+int uart_putchar(char c)
+{
+	return uart_write(&c, 1) == 1;
 }
 
 // Blocking version with timeout - waits for buffer space
@@ -216,7 +724,8 @@ int uart_putchar_blocking(char c, uint32_t timeout_ms)
 
 	while (!uart_putchar(c))
 	{
-		// Check timeout
+		// Advance the polled timebase, then check the timeout
+		timebase_poll();
 		if ((timer_tick_count - start_time) >= timeout_ms)
 		{
 			return 0; // Timeout
@@ -232,21 +741,53 @@ void uart_flush(void)
 	// Wait until TX buffer is empty
 	while (tx_head != tx_tail)
 	{
-		// Busy wait - could yield to other tasks here
+		// Keep the millisecond timebase current while waiting
+		timebase_poll();
+	}
+}
+
+// Reprogram the UART divisor for a new baud rate. Drains the TX ring
+// first so the tail of the previous response leaves at the old rate.
+void uart_set_baud(uint32_t baud)
+{
+	// Round to the nearest divisor for minimal rate error
+	uint32_t divisor = (ALT_CPU_FREQ + baud / 2) / baud - 1;
+
+	uart_flush();
+	// The ring is empty but the last byte may still be in the shift
+	// register - wait for TMT so it is not garbled by the rate change
+	while (!(IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE) &
+	         ALTERA_AVALON_UART_STATUS_TMT_MSK))
+	{
+		timebase_poll();
 	}
+	IOWR_ALTERA_AVALON_UART_DIVISOR(UART_0_BASE, divisor);
+	uart_current_baud = baud;
 }
 
 void uart_puts(const char *str)
 {
+	// Write runs of plain characters as one block; only newlines need
+	// special handling for the LF -> CRLF terminal conversion
+	const char *seg = str;
+
 	while (*str)
 	{
-		char c = *str++;
-		// Auto-convert LF to CRLF for proper terminal display
-		if (c == '\n')
+		if (*str == '\n')
 		{
-			uart_putchar('\r');
+			if (str > seg)
+			{
+				uart_write(seg, (uint16_t)(str - seg));
+			}
+			uart_write("\r\n", 2);
+			seg = str + 1;
 		}
-		uart_putchar(c);
+		str++;
+	}
+
+	if (str > seg)
+	{
+		uart_write(seg, (uint16_t)(str - seg));
 	}
 }
 
@@ -273,320 +814,2110 @@ void jtag_puts(const char *str)
 	}
 }
 
-void jtag_put_int(int num)
+// ========== LEVELED JTAG DEBUG LOGGING ==========
+// The debug prints used to run unconditionally, and every character
+// polls the JTAG UART control register whether or not a debugger is
+// attached. Log calls now carry a level:
+//   ERROR - anomalies (fallbacks, drops) that must never be silent
+//   INFO  - boot progress and one-off state changes
+//   TRACE - periodic chatter like the PIO toggle dump
+// LOG_BUILD_LEVEL is the compile-time ceiling - override it on the
+// compiler command line (e.g. -DLOG_BUILD_LEVEL=LOG_LEVEL_ERROR for the
+// deployed build) and everything above it is dead code costing zero
+// cycles. Lab builds can restrict further at runtime with J<level>.
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_TRACE 3
+
+#ifndef LOG_BUILD_LEVEL
+#define LOG_BUILD_LEVEL LOG_LEVEL_TRACE
+#endif
+
+// Runtime level, J<level> command; starts fully open so lab behavior
+// matches the old unconditional prints
+static uint8_t log_runtime_level = LOG_LEVEL_TRACE;
+
+// True if a message at 'level' should be emitted. With a constant level
+// the build-ceiling comparison folds at compile time, so a call above
+// the ceiling disappears entirely.
+#define LOG_ENABLED(level) \
+	((level) <= LOG_BUILD_LEVEL && (level) <= log_runtime_level)
+
+#define LOG_PUTS(level, str) \
+	do { if (LOG_ENABLED(level)) jtag_puts(str); } while (0)
+#define LOG_PUT_INT(level, num) \
+	do { if (LOG_ENABLED(level)) jtag_put_int(num); } while (0)
+
+// ========== DIVISION-FREE NUMBER FORMATTING ==========
+// The CPU has no hardware divider (ALT_CPU_HARDWARE_DIVIDE_PRESENT 0),
+// so the classic '% 10' / '/ 10' digit loop costs two software-division
+// library calls per digit. Repeated subtraction of powers of ten needs
+// at most 9 subtract-compare iterations per digit instead.
+
+// Format a signed integer as decimal into buf (no terminator).
+// Returns the number of characters written (buf must hold 12).
+static int format_int(int num, char *buf)
 {
-	char buffer[12];
-	int i = 0;
-	int is_negative = 0;
+	static const uint32_t pow10[10] = {
+		1000000000u, 100000000u, 10000000u, 1000000u, 100000u,
+		10000u, 1000u, 100u, 10u, 1u
+	};
+	uint32_t value;
+	int len = 0;
+	int started = 0;
+	int i;
 
 	if (num < 0)
 	{
-		is_negative = 1;
-		num = -num;
+		buf[len++] = '-';
+		value = (uint32_t)0 - (uint32_t)num; // Two's complement, INT_MIN safe
 	}
-
-	if (num == 0)
+	else
 	{
-		jtag_putchar('0');
-		return;
+		value = (uint32_t)num;
 	}
 
-	while (num > 0)
+	for (i = 0; i < 10; i++)
 	{
-		buffer[i++] = '0' + (num % 10);
-		num /= 10;
+		char digit = '0';
+		while (value >= pow10[i])
+		{
+			value -= pow10[i];
+			digit++;
+		}
+		// Suppress leading zeros but always emit the last digit
+		if (digit != '0' || started || i == 9)
+		{
+			buf[len++] = digit;
+			started = 1;
+		}
 	}
 
-	if (is_negative)
-	{
-		jtag_putchar('-');
-	}
+	return len;
+}
+
+void jtag_put_int(int num)
+{
+	char buffer[12];
+	int len = format_int(num, buffer);
+	int i;
 
-	while (i > 0)
+	for (i = 0; i < len; i++)
 	{
-		jtag_putchar(buffer[--i]);
+		jtag_putchar(buffer[i]);
 	}
 }
 
 void uart_put_int(int num)
 {
 	char buffer[12];
-	int i = 0;
-	int is_negative = 0;
+	int len = format_int(num, buffer);
 
-	if (num < 0)
+	uart_write(buffer, (uint16_t)len);
+}
+
+// Fixed-width hex output for machine-mode responses - four table lookups,
+// no division or decimal conversion at all
+void uart_put_hex16(uint16_t value)
+{
+	static const char hex_digits[16] = "0123456789ABCDEF";
+	char buffer[4];
+
+	buffer[0] = hex_digits[(value >> 12) & 0xF];
+	buffer[1] = hex_digits[(value >> 8) & 0xF];
+	buffer[2] = hex_digits[(value >> 4) & 0xF];
+	buffer[3] = hex_digits[value & 0xF];
+	uart_write(buffer, 4);
+}
+
+
+// Print one profiling scope: <name>: n=<count> min=<min> max=<max> avg=<avg>
+// All values in CPU cycles at 120 MHz
+static void prof_print(const char *name, volatile prof_stat_t *s)
+{
+	uart_puts(name);
+	uart_puts(": n=");
+	uart_put_int((int)s->count);
+	uart_puts(" min=");
+	uart_put_int(s->count ? (int)s->min : 0);
+	uart_puts(" max=");
+	uart_put_int((int)s->max);
+	uart_puts(" avg=");
+	uart_put_int(s->count ? (int)(s->total / s->count) : 0);
+	uart_puts("\n");
+}
+
+// ========== ON-TARGET MICRO-BENCHMARK ==========
+// The X command measures, on the target itself, the building blocks
+// every firmware and Qsys change touches: Avalon write/read throughput
+// to the MM bridge, TX ring enqueue rate, and effective wire throughput
+// at the current baud rate. Results in cycles and bytes/sec, so a
+// regression shows up in one command instead of a scope session.
+
+// Number of full register-file passes per bus measurement
+#define BENCH_BUS_PASSES 10
+// TX benchmark block size (must fit the empty TX ring)
+#define BENCH_TX_BYTES 256
+
+// Current time in cycles, extended by the millisecond tick so intervals
+// longer than one timer period measure correctly (unlike prof_elapsed)
+static uint32_t bench_cycles_now(void)
+{
+	// Fold everything elapsed so far into the tick counters, then
+	// combine ticks with the sub-millisecond residue
+	timebase_poll();
+	return timer_tick_count * PROF_TIMER_PERIOD + timebase_cycle_acc;
+}
+
+// Report one benchmark line: X:<name> cycles=<c> [rate=<r> B/s]
+static void bench_report(const char *name, uint32_t cycles, uint32_t bytes)
+{
+	uart_puts("X:");
+	uart_puts(name);
+	uart_puts(" cycles=");
+	uart_put_int((int)cycles);
+	if (bytes > 0 && cycles > 0)
 	{
-		is_negative = 1;
-		num = -num;
+		// bytes * f_cpu overflows 32 bits, so widen for the rate math
+		uint32_t rate = (uint32_t)(((uint64_t)bytes * ALT_CPU_FREQ) / cycles);
+		uart_puts(" rate=");
+		uart_put_int((int)rate);
+		uart_puts(" B/s");
 	}
+	uart_puts("\n");
+}
+
+// Run all benchmarks and print one line each
+static void run_benchmark(void)
+{
+	static char tx_block[BENCH_TX_BYTES];
+	uint32_t t0;
+	uint32_t cycles;
+	uint32_t checksum = 0;
+	int pass;
+	int i;
 
-	// Handle zero case
-	if (num == 0)
+	// --- Avalon bus write throughput ---
+	// Rewrites the shadow values, so the filter configuration is unchanged
+	t0 = bench_cycles_now();
+	for (pass = 0; pass < BENCH_BUS_PASSES; pass++)
 	{
-		uart_putchar('0');
-		return;
+		for (i = 0; i < COEFF_REG_COUNT; i++)
+		{
+			IOWR_32DIRECT(MM_BRIDGE_0_BASE, i * 4, (uint32_t)coeff_shadow[i]);
+		}
 	}
+	cycles = bench_cycles_now() - t0;
+	bench_report("bus_write_650", cycles, 0);
 
-	// Convert number to string (reversed)
-	while (num > 0)
+	// --- Burst block-copy throughput (the commit path) ---
+	t0 = bench_cycles_now();
+	for (pass = 0; pass < BENCH_BUS_PASSES; pass++)
 	{
-		buffer[i++] = '0' + (num % 10);
-		num /= 10;
+		fir_write_block(coeff_shadow, COEFF_REG_COUNT);
 	}
+	cycles = bench_cycles_now() - t0;
+	bench_report("blk_write_650", cycles, 0);
 
-	// Print negative sign if needed
-	if (is_negative)
+	// --- Avalon bus read throughput ---
+	t0 = bench_cycles_now();
+	for (pass = 0; pass < BENCH_BUS_PASSES; pass++)
 	{
-		uart_putchar('-');
+		for (i = 0; i < COEFF_REG_COUNT; i++)
+		{
+			checksum += IORD_32DIRECT(MM_BRIDGE_0_BASE, i * 4);
+		}
 	}
-
-	// Print digits in correct order
-	while (i > 0)
+	cycles = bench_cycles_now() - t0;
+	// Keep the reads from being optimized away
+	if (checksum == 0xDEADBEEF)
 	{
-		uart_putchar(buffer[--i]);
+		uart_putchar(' ');
 	}
+	bench_report("bus_read_650", cycles, 0);
+
+	// --- TX ring enqueue rate ---
+	// Start from an empty ring so the whole block is accepted
+	memset(tx_block, '.', BENCH_TX_BYTES);
+	uart_flush();
+	t0 = bench_cycles_now();
+	uart_write(tx_block, BENCH_TX_BYTES);
+	cycles = bench_cycles_now() - t0;
+	bench_report("tx_enqueue_256", cycles, BENCH_TX_BYTES);
+
+	// --- Effective wire throughput at the current baud rate ---
+	t0 = bench_cycles_now();
+	uart_flush();
+	cycles = bench_cycles_now() - t0;
+	uart_puts("\n");
+	bench_report("wire_256", cycles, BENCH_TX_BYTES);
 }
 
-// Custom function to parse integer from string
-int parse_int(const char *str, int *result)
-{
-	int value = 0;
-	int i = 0;
-	int digit_found = 0;
+// ========== ON-TARGET FIR COEFFICIENT SYNTHESIS ==========
+// F<type>$<cutoff>[,<cutoff2>] designs the windowed-sinc coefficients
+// directly on the Nios II and commits them - Hamming window, 48 kHz
+// sample rate, 64 taps, types lp/hp/bp/bs, exactly the host tool's
+// parameter space. A filter change then costs ~10 bytes of UART traffic
+// instead of a 64-command upload. All math is fixed point: Q15 sine
+// from a quarter-wave table, Q20 intermediate taps. Software division
+// is fine here - synthesis is a cold path, not the ISR.
+// Like the host tool, hp/bs are designed with 65 taps (they need a
+// center tap) and the center is deleted to fit the 64-tap hardware.
+#define FIR_SYNTH_FS 48000
+#define FIR_SYNTH_TAPS 64
+
+// sin(i * pi/128) in Q15, first quadrant (65 entries)
+static const int16_t sin_table_q15[65] = {
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+	6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767
+};
 
-	// Skip whitespace
-	while (str[i] == ' ' || str[i] == '\t')
-		i++;
+// Q15 sine; phase in 1/65536 of a full turn. Quarter-wave table plus
+// linear interpolation - worst-case error is about 2 LSB.
+static int16_t sin_q15(uint16_t phase)
+{
+	uint16_t quadrant = phase >> 14;
+	uint16_t p = phase & 0x3FFF;
+	uint16_t idx;
+	uint16_t frac;
+	int32_t v;
 
-	// Parse digits
-	while (isdigit(str[i]))
+	if (quadrant & 1)
 	{
-		value = value * 10 + (str[i] - '0');
-		i++;
-		digit_found = 1;
+		p = (uint16_t)(0x4000 - p);
 	}
-
-	if (digit_found)
+	idx = p >> 8;
+	frac = p & 0xFF;
+	// At exactly 90 degrees p folds to 0x4000: idx 64, frac 0 - no
+	// interpolation, and no read past the end of the table
+	v = sin_table_q15[idx];
+	if (frac)
 	{
-		*result = value;
-		return 1; // Success
+		v += ((int32_t)(sin_table_q15[idx + 1] - sin_table_q15[idx]) * frac) >> 8;
 	}
-	return 0; // Failure
+
+	return (int16_t)((quadrant >= 2) ? -v : v);
 }
 
-// Custom function to parse signed integer from string
-int parse_signed_int(const char *str, int16_t *result)
+// Q15 cosine via the quarter-turn shift
+static int16_t cos_q15(uint16_t phase)
 {
-	int32_t value = 0;
-	int i = 0;
-	int digit_found = 0;
-	int is_negative = 0;
+	return sin_q15((uint16_t)(phase + 0x4000));
+}
 
-	// Skip whitespace
-	while (str[i] == ' ' || str[i] == '\t')
-		i++;
+// Hamming window value for tap n of an ntaps filter, Q15:
+// 0.54 - 0.46 * cos(2*pi*n / (ntaps-1))
+static int16_t hamming_q15(int n, int ntaps)
+{
+	uint16_t phase = (uint16_t)(((uint32_t)n << 16) / (uint32_t)(ntaps - 1));
+	int32_t w = 17695 - ((15073 * (int32_t)cos_q15(phase)) >> 15);
 
-	// Check for sign
-	if (str[i] == '-')
-	{
-		is_negative = 1;
-		i++;
-	}
-	else if (str[i] == '+')
+	if (w > 32767)
 	{
-		i++;
+		w = 32767;
 	}
+	return (int16_t)w;
+}
 
-	// Parse digits
-	while (isdigit(str[i]))
-	{
-		value = value * 10 + (str[i] - '0');
-		i++;
-		digit_found = 1;
-	}
+// Windowed-sinc lowpass, normalized to unity DC gain, taps in Q20.
+// ntaps may be even (half-sample center) or odd.
+static void fir_synth_lowpass_q20(int32_t cutoff, int ntaps, int32_t *dst)
+{
+	int64_t sum = 0;
+	int n;
 
-	if (digit_found)
+	for (n = 0; n < ntaps; n++)
 	{
-		if (is_negative)
-			value = -value;
+		// Doubled distance from the (possibly half-sample) center, so
+		// the ideal-filter argument x = cutoff * k2 / fs stays integer
+		int k2 = 2 * n - (ntaps - 1);
+		int32_t tap;
 
-		// Check if value fits in 16-bit signed range
-		if (value >= -32768 && value <= 32767)
+		if (k2 == 0)
+		{
+			tap = 1 << 20; // sinc(0) = 1
+		}
+		else
 		{
-			*result = (int16_t)value;
-			return 1; // Success
+			if (k2 < 0)
+			{
+				k2 = -k2; // sinc is even
+			}
+			// x in Q16; sin(pi*x) has phase x/2 turns
+			int64_t x_q16 = ((int64_t)cutoff * k2 << 16) / FIR_SYNTH_FS;
+			int16_t s = sin_q15((uint16_t)((x_q16 >> 1) & 0xFFFF));
+			// pi*x in Q12 (pi ~= 12868/4096)
+			int32_t pix_q12 = (int32_t)((x_q16 * 12868) >> 16);
+
+			if (pix_q12 == 0)
+			{
+				// Cutoffs of a few Hz truncate pi*x to zero in Q12;
+				// dividing would hit the soft-division library with 0.
+				// Use the small-argument limit sinc(x) -> 1 instead.
+				tap = 1 << 20;
+			}
+			else
+			{
+				// sinc = sin(pi*x) / (pi*x): Q15 << 17 / Q12 -> Q20
+				tap = (int32_t)(((int64_t)s << 17) / pix_q12);
+			}
 		}
+
+		// Apply the window
+		tap = (int32_t)(((int64_t)tap * hamming_q15(n, ntaps)) >> 15);
+		dst[n] = tap;
+		sum += tap;
+	}
+
+	// Normalize the tap sum (DC gain) to exactly 1.0 in Q20
+	for (n = 0; n < ntaps; n++)
+	{
+		dst[n] = (int32_t)(((int64_t)dst[n] << 20) / sum);
 	}
-	return 0; // Failure
 }
 
+// Scratch tap sets in Q20 - static, the stack is small
+static int32_t synth_a[FIR_SYNTH_TAPS + 1];
+static int32_t synth_b[FIR_SYNTH_TAPS + 1];
 
-// Process console input for commands using interrupt-driven input
-// Commands:
-//   S<addr>$<value> - Set register at address (0-64) with signed 16-bit value
-//   R<addr>         - Read from register at address (0-64)
-//   T<interval>     - Set PIO timer interval
-void process_console_input(volatile uint32_t *delay_value)
+// Synthesize FIR_SYNTH_TAPS Q1.15 taps into out. type is "LP", "HP",
+// "BP" or "BS"; c2 is only used by BP/BS. Returns 0 on success.
+static int fir_synth(const char *type, int32_t c1, int32_t c2, int16_t *out)
 {
-	static char cmd_buffer[32];
-	static int buffer_idx = 0;
-	char c;
-	int addr;
-	int16_t value_signed;
-	int value;
-	uint32_t read_value;
-	char *dollar_pos;
-	int i;
+	int ntaps = FIR_SYNTH_TAPS;
+	int n;
 
-	// Check if a character was received via interrupt
-	if (uart_rx_flag)
+	if (type[0] == 'L')
 	{
-		c = uart_rx_char;
-		uart_rx_flag = 0; // Clear the flag
-
-		// Handle Enter key
-		if (c == '\r' || c == '\n')
+		fir_synth_lowpass_q20(c1, ntaps, synth_a);
+	}
+	else if (type[0] == 'H')
+	{
+		// Spectral inversion of a lowpass needs a true center tap
+		ntaps = FIR_SYNTH_TAPS + 1;
+		fir_synth_lowpass_q20(c1, ntaps, synth_a);
+		for (n = 0; n < ntaps; n++)
 		{
-			// Echo newline
-			uart_puts("\n");
+			synth_a[n] = -synth_a[n];
+		}
+		synth_a[ntaps / 2] += 1 << 20;
+	}
+	else if (type[1] == 'P')
+	{
+		// Bandpass = lp(c2) - lp(c1)
+		fir_synth_lowpass_q20(c2, ntaps, synth_a);
+		fir_synth_lowpass_q20(c1, ntaps, synth_b);
+		for (n = 0; n < ntaps; n++)
+		{
+			synth_a[n] -= synth_b[n];
+		}
+	}
+	else
+	{
+		// Bandstop = lp(c1) + hp(c2), again via a center tap
+		ntaps = FIR_SYNTH_TAPS + 1;
+		fir_synth_lowpass_q20(c1, ntaps, synth_a);
+		fir_synth_lowpass_q20(c2, ntaps, synth_b);
+		for (n = 0; n < ntaps; n++)
+		{
+			synth_a[n] -= synth_b[n];
+		}
+		synth_a[ntaps / 2] += 1 << 20;
+	}
 
-			cmd_buffer[buffer_idx] = '\0';
+	// Odd designs lose their center tap to fit the 64-tap hardware,
+	// the same workaround the host tool applies
+	if (ntaps > FIR_SYNTH_TAPS)
+	{
+		for (n = ntaps / 2; n < FIR_SYNTH_TAPS; n++)
+		{
+			synth_a[n] = synth_a[n + 1];
+		}
+	}
 
-			// Parse command based on first character
-			if (buffer_idx > 0)
-			{
-				// S<addr>$<value> - Set register command
-				if (cmd_buffer[0] == 'S' || cmd_buffer[0] == 's')
-				{
-					// Find the dollar sign separator
-					dollar_pos = NULL;
-					for (i = 1; i < buffer_idx; i++)
-					{
-						if (cmd_buffer[i] == '$')
-						{
-							dollar_pos = &cmd_buffer[i];
-							break;
-						}
-					}
-
-					if (dollar_pos != NULL)
-					{
-						// Parse address (between 'S' and '$')
-						*dollar_pos = '\0'; // Temporarily null-terminate
-						if (parse_int(&cmd_buffer[1], &addr))
-						{
-							if (addr >= 0 && addr <= 64)
-							{
-								// Parse signed value (after '$')
-								if (parse_signed_int(dollar_pos + 1, &value_signed))
-								{
-									// Write to MM bridge at calculated address
-									IOWR_32DIRECT(MM_BRIDGE_0_BASE, addr * 4, (uint32_t)value_signed);
-									uart_puts("Set reg[");
-									uart_put_int(addr);
-									uart_puts("] = ");
-									uart_put_int((int)value_signed);
-									uart_puts("\n");
-								}
-								else
-								{
-									uart_puts("Invalid value (must be signed 16-bit: -32768 to 32767).\n");
-								}
-							}
-							else
-							{
-								uart_puts("Address out of range (0-64).\n");
-							}
-						}
-						else
-						{
-							uart_puts("Invalid address.\n");
-						}
-					}
-					else
-					{
-						uart_puts("Invalid format. Use S<addr>$<value>\n");
-					}
-				}
-				// R<addr> - Read register command
-				else if (cmd_buffer[0] == 'R' || cmd_buffer[0] == 'r')
-				{
-					if (parse_int(&cmd_buffer[1], &addr))
-					{
-						if (addr >= 0 && addr <= 64)
-						{
-							// Read from MM bridge at calculated address
-							read_value = IORD_32DIRECT(MM_BRIDGE_0_BASE, addr * 4);
-							uart_puts("Read reg[");
-							uart_put_int(addr);
-							uart_puts("] = ");
-							// Cast to int16_t first to get proper sign extension, then to int for display
-							uart_put_int((int)(int16_t)read_value);
-							uart_puts("\n");
-						}
-						else
-						{
-							uart_puts("Address out of range (0-64).\n");
-						}
-					}
-					else
-					{
-						uart_puts("Invalid address.\n");
-					}
-				}
-				// T<interval> - Set PIO timer interval
-				else if (cmd_buffer[0] == 'T' || cmd_buffer[0] == 't')
-				{
-					if (parse_int(&cmd_buffer[1], &value))
-					{
-						if (value <= 5000 && value >= 100)
-						{
-							*delay_value = value;
-							uart_puts("Timer interval set to: ");
-							uart_put_int(value);
-							uart_puts(" ms\n");
-						}
-						else
-						{
-							uart_puts("Value out of range (100-5000).\n");
-						}
-					}
-					else
-					{
-						uart_puts("Invalid integer value.\n");
-					}
-				}
-				else
-				{
-					uart_puts("Unknown command. Use S<addr>$<value>, R<addr>, or T<interval>\n");
-				}
-			}
+	// Q20 -> Q1.15 with rounding and clipping
+	for (n = 0; n < FIR_SYNTH_TAPS; n++)
+	{
+		int32_t v = (synth_a[n] + (1 << 4)) >> 5;
 
-			// Reset buffer
-			buffer_idx = 0;
+		if (v > 32767)
+		{
+			v = 32767;
 		}
-		// Add character to buffer
-		else if (buffer_idx < sizeof(cmd_buffer) - 1)
+		else if (v < -32767)
 		{
-			// Echo the character back to the console
-			uart_putchar(c);
-			cmd_buffer[buffer_idx++] = c;
+			v = -32767;
 		}
+		out[n] = (int16_t)v;
 	}
+
+	return 0;
 }
 
-int main()
+// ========== AUDIO SAMPLE CAPTURE ==========
+// A[<n>] snapshots up to 256 input/output sample pairs of the FIR and
+// streams them out over the otherwise-idle JTAG UART in the background,
+// so filter validation happens at the desk instead of with a scope on
+// the codec pins. The samples are read from two read-only registers in
+// the extended MM bridge window past the coefficient file (the bridge
+// spans 256 registers, the coefficient file uses 0-64); pairs are taken
+// at the 48 kHz sample period, paced by timer snapshots. Streaming is
+// chunked from the main loop - a few lines per wakeup, only when the
+// JTAG write FIFO has room - so the RS232 console stays responsive.
+#define CAPTURE_MAX_PAIRS 256
+#define CAPTURE_REG_IN  66 // Current FIR input sample (read-only)
+#define CAPTURE_REG_OUT 67 // Current FIR output sample (read-only)
+// One 48 kHz sample period in CPU cycles
+#define CAPTURE_SAMPLE_CYCLES (ALT_CPU_FREQ / FIR_SYNTH_FS)
+// Pairs streamed per main-loop wakeup
+#define CAPTURE_PAIRS_PER_STEP 4
+
+static int16_t capture_in[CAPTURE_MAX_PAIRS];
+static int16_t capture_out[CAPTURE_MAX_PAIRS];
+static uint16_t capture_count = 0;      // Pairs collected by the last arm
+static uint16_t capture_stream_pos = 0; // Next pair to stream
+static uint8_t capture_streaming = 0;   // Background stream in progress
+
+// Collect 'pairs' sample pairs back-to-back, one per sample period.
+// Blocks for pairs/48 ms (5.3 ms for a full buffer) - short enough that
+// the RX ring absorbs any console input arriving meanwhile.
+static void capture_run(int pairs)
 {
-	uint8_t pio_state = 0;
-	volatile uint32_t delay_value = 1000; // Default delay value in ms (1 second)
-	uint32_t debug_counter = 0; // Counter for periodic debug messages
+	uint32_t last = prof_snapshot_atomic();
+	int i;
 
-	// Register Timer interrupt handler
-	alt_ic_isr_register(TIMER_0_IRQ_INTERRUPT_CONTROLLER_ID,
-	                    TIMER_0_IRQ,
-	                    timer_isr,
-	                    NULL,
-	                    0x0);
+	for (i = 0; i < pairs; i++)
+	{
+		capture_in[i] = (int16_t)IORD_32DIRECT(MM_BRIDGE_0_BASE,
+		                                       CAPTURE_REG_IN * 4);
+		capture_out[i] = (int16_t)IORD_32DIRECT(MM_BRIDGE_0_BASE,
+		                                        CAPTURE_REG_OUT * 4);
+
+		// Hold off until the next sample period. The whole run spans
+		// several timer periods, so keep the polled millisecond
+		// timebase fed while waiting (see timebase_poll)
+		while (prof_elapsed(last, prof_snapshot_atomic()) <
+		       CAPTURE_SAMPLE_CYCLES)
+		{
+			timebase_poll();
+		}
+		last = prof_snapshot_atomic();
+	}
+
+	capture_count = (uint16_t)pairs;
+	capture_stream_pos = 0;
+	capture_streaming = 1;
+}
+
+// Stream a few captured pairs per call (one line per pair,
+// "CAP:<in>,<out>"). Called from the main loop between events; backs
+// off whenever the JTAG write FIFO is low, because jtag_putchar drops
+// characters when it is full.
+static void capture_stream_step(void)
+{
+	int lines = 0;
+
+	while (capture_stream_pos < capture_count &&
+	       lines < CAPTURE_PAIRS_PER_STEP)
+	{
+		uint32_t control =
+			IORD_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_0_BASE);
+
+		// WSPACE must hold a worst-case line plus the END marker
+		if ((control & 0xFFFF) < 32)
+		{
+			return; // Resume on a later wakeup
+		}
+
+		jtag_puts("CAP:");
+		jtag_put_int((int)capture_in[capture_stream_pos]);
+		jtag_putchar(',');
+		jtag_put_int((int)capture_out[capture_stream_pos]);
+		jtag_putchar('\n');
+		capture_stream_pos++;
+		lines++;
+	}
+
+	if (capture_stream_pos >= capture_count)
+	{
+		jtag_puts("CAP:END\n");
+		capture_streaming = 0;
+	}
+}
+
+// ========== WATCH MODE (push notifications) ==========
+// Monitoring hosts used to poll R<addr> and the counters on a timer,
+// re-reading mostly unchanged values. With N the host subscribes once
+// and the firmware pushes one compact line only when a watched value
+// actually changes; the check piggybacks on the periodic PIO toggle
+// pacing in main(), so it costs nothing between intervals.
+//   N<addr>  - toggle a watch on a bridge register (0-255, bus read)
+//   NE       - toggle the error-counter group (PE/FE/OE/RXDROP)
+//   N        - list active watches
+//   N!       - clear all watches
+// Notifications: "N:<addr>=<value>" / "N:PE=.. FE=.. OE=.. DROP=.."
+#define WATCH_REG_COUNT 256 // Full MM bridge span
+
+static uint32_t watch_mask[WATCH_REG_COUNT / 32]; // Bit per register
+static int16_t watch_last[WATCH_REG_COUNT];       // Last pushed values
+static uint8_t watch_errors = 0;                  // Error group watched
+static uint32_t watch_err_last[4];                // PE, FE, OE, RXDROP
+
+// Compare every watched value against its last pushed state and emit a
+// notification line for each change. Called from the toggle branch.
+static void watch_check(void)
+{
+	int word;
+	int bit;
+
+	for (word = 0; word < WATCH_REG_COUNT / 32; word++)
+	{
+		uint32_t mask = watch_mask[word];
+
+		if (mask == 0)
+		{
+			continue;
+		}
+		for (bit = 0; bit < 32; bit++)
+		{
+			if (mask & (1u << bit))
+			{
+				int addr = word * 32 + bit;
+				int16_t value =
+					(int16_t)IORD_32DIRECT(MM_BRIDGE_0_BASE, addr * 4);
+
+				if (value != watch_last[addr])
+				{
+					watch_last[addr] = value;
+					uart_puts("N:");
+					uart_put_int(addr);
+					uart_putchar('=');
+					uart_put_int((int)value);
+					uart_puts("\n");
+				}
+			}
+		}
+	}
+
+	if (watch_errors)
+	{
+		uint32_t now[4];
+
+		now[0] = uart_parity_errors;
+		now[1] = uart_frame_errors;
+		now[2] = uart_overrun_errors;
+		now[3] = uart_rx_dropped;
+		if (memcmp(now, watch_err_last, sizeof(now)) != 0)
+		{
+			memcpy(watch_err_last, now, sizeof(watch_err_last));
+			uart_puts("N:PE=");
+			uart_put_int((int)now[0]);
+			uart_puts(" FE=");
+			uart_put_int((int)now[1]);
+			uart_puts(" OE=");
+			uart_put_int((int)now[2]);
+			uart_puts(" DROP=");
+			uart_put_int((int)now[3]);
+			uart_puts("\n");
+		}
+	}
+}
+
+// ========== BINARY COMMAND MODE (machine interface) ==========
+// Entered from the ASCII console via ESC 'B'. Frames are length-prefixed:
+// <len> <opcode> <payload...>, no echo, single-byte ACK/NAK responses.
+// See the file header for the full frame description.
+
+#define BIN_OP_EXIT 0x00
+#define BIN_OP_SET 0x01
+#define BIN_OP_GET 0x02
+#define BIN_OP_COMMIT 0x03
+
+#define BIN_ACK 0x06
+#define BIN_NAK 0x15
+
+// Longest frame is SET: opcode + addr + 2 value bytes
+#define BIN_FRAME_MAX 4
+
+// 0 = ASCII console (default), 1 = binary framing
+static uint8_t binary_mode = 0;
+// Set when ESC was received in ASCII mode and we wait for the mode letter
+static uint8_t escape_pending = 0;
+
+// Consume one received byte while in binary mode
+static void binary_mode_input(uint8_t c)
+{
+	static uint8_t frame[BIN_FRAME_MAX];
+	static uint8_t frame_fill = 0;
+	static uint8_t frame_len = 0; // 0 = waiting for length byte
+	uint32_t read_value;
+	int addr;
+
+	// First byte of a frame is the length of opcode + payload
+	if (frame_len == 0)
+	{
+		if (c == 0 || c > BIN_FRAME_MAX)
+		{
+			// Unusable length - reject immediately so the host can resync
+			uart_putchar((char)BIN_NAK);
+			return;
+		}
+		frame_len = c;
+		frame_fill = 0;
+		return;
+	}
+
+	// Collect frame bytes until the announced length is reached
+	frame[frame_fill++] = c;
+	if (frame_fill < frame_len)
+	{
+		return;
+	}
+	frame_len = 0; // Frame complete - next byte starts a new one
+
+	switch (frame[0])
+	{
+	case BIN_OP_SET:
+		// opcode, addr, value_lo, value_hi - staged like the ASCII S command
+		addr = frame[1];
+		if (frame_fill == 4 && addr <= 64)
+		{
+			coeff_stage(addr, (int16_t)(uint16_t)(frame[2] | (frame[3] << 8)));
+			uart_putchar((char)BIN_ACK);
+		}
+		else
+		{
+			uart_putchar((char)BIN_NAK);
+		}
+		break;
+
+	case BIN_OP_COMMIT:
+		// Commit the staged bank to the MM bridge
+		coeff_commit();
+		uart_putchar((char)BIN_ACK);
+		break;
+
+	case BIN_OP_GET:
+		// opcode, addr - respond with value_lo value_hi (from the shadow)
+		addr = frame[1];
+		if (frame_fill == 2 && addr <= 64)
+		{
+			read_value = (uint32_t)(uint16_t)coeff_shadow[addr];
+			uart_putchar((char)(read_value & 0xFF));
+			uart_putchar((char)((read_value >> 8) & 0xFF));
+		}
+		else
+		{
+			uart_putchar((char)BIN_NAK);
+		}
+		break;
+
+	case BIN_OP_EXIT:
+		// Back to the interactive ASCII console
+		binary_mode = 0;
+		uart_putchar((char)BIN_ACK);
+		uart_puts("\nReady> ");
+		break;
+
+	default:
+		uart_putchar((char)BIN_NAK);
+		break;
+	}
+}
+
+// ========== TABLE-DRIVEN INCREMENTAL COMMAND PARSER ==========
+// The old if/else cascade buffered a whole line and re-scanned it for
+// separators after Enter. Commands are now dispatched through a table
+// indexed by the opcode byte, and the numeric fields are accumulated
+// digit by digit as the characters arrive - by end-of-line the command
+// executes immediately with zero re-scanning, at constant per-character
+// cost no matter how many commands exist.
+
+// PIO toggle interval in ms, set by the T command (read by main())
+volatile uint32_t pio_toggle_interval = 1000;
+
+// Per-line parser state, reset after every end-of-line
+static char parse_op = 0;              // Active command letter (uppercase)
+static uint8_t parse_unknown = 0;      // Unknown opcode - swallow until EOL
+static int32_t parse_addr = 0;         // First numeric field (before '$')
+static uint8_t parse_addr_digits = 0;
+static uint8_t parse_bang = 0;         // '!' modifier (R!<addr>, L<idx>!)
+static int32_t parse_value = 0;        // Second numeric field (after '$')
+static uint8_t parse_value_digits = 0;
+static uint8_t parse_value_neg = 0;
+static uint8_t parse_field = 0;        // 0 = address field, 1 = value field
+static uint8_t parse_name_mode = 0;    // Capturing text after '=' (L rename)
+static char parse_name[PRESET_NAME_LEN];
+static uint8_t parse_name_len = 0;
+static int parse_wcount = 0;           // Values staged so far by a W command
+static char parse_ftype[2];            // Filter type letters (F command)
+static uint8_t parse_ftype_len = 0;
+static int32_t parse_cut1 = 0;         // First cutoff of F, set at the ','
+static uint8_t parse_cut1_set = 0;
+static uint8_t parse_brace = 0;        // '{' modifier (M<slot>{ record)
+static const char *parse_error = NULL; // First error on this line
+
+// CRC-framed protocol state: a line of the form #<seq>:<command>*<crc8>
+// carries a sequence number and a CRC8 (poly 0x07, init 0x00, over
+// "<seq>:<command>"). The command body feeds the same incremental
+// parser; the response comes back framed the same way, and a corrupted
+// frame is NAKed immediately instead of being silently ignored.
+static uint8_t frame_active = 0;    // Line started with '#'
+static uint8_t frame_stage = 0;     // 0 = seq, 1 = command, 2 = crc digits
+static uint32_t frame_seq = 0;
+static uint8_t frame_seq_digits = 0;
+static uint8_t frame_crc_calc = 0;  // Running CRC8 over "<seq>:<command>"
+static uint8_t frame_crc_rx = 0;
+static uint8_t frame_crc_digits = 0;
+static uint8_t frame_bad = 0;       // Framing violation seen on this line
+
+static void parser_reset(void)
+{
+	frame_active = 0;
+	frame_stage = 0;
+	frame_seq = 0;
+	frame_seq_digits = 0;
+	frame_crc_calc = 0;
+	frame_crc_rx = 0;
+	frame_crc_digits = 0;
+	frame_bad = 0;
+	parse_op = 0;
+	parse_unknown = 0;
+	parse_addr = 0;
+	parse_addr_digits = 0;
+	parse_bang = 0;
+	parse_value = 0;
+	parse_value_digits = 0;
+	parse_value_neg = 0;
+	parse_field = 0;
+	parse_name_mode = 0;
+	parse_name_len = 0;
+	parse_wcount = 0;
+	parse_ftype_len = 0;
+	parse_cut1 = 0;
+	parse_cut1_set = 0;
+	parse_brace = 0;
+	parse_error = NULL;
+}
+
+// Signed result of the value field
+static int32_t parse_value_signed(void)
+{
+	return parse_value_neg ? -parse_value : parse_value;
+}
+
+// Finish the current value of a W list: range-check and stage it
+static void parse_w_value_done(void)
+{
+	int32_t v;
+
+	if (parse_error != NULL)
+	{
+		return;
+	}
+	if (!parse_addr_digits || parse_addr > 64)
+	{
+		parse_error = "Invalid start address (0-64).";
+		return;
+	}
+	if (!parse_value_digits)
+	{
+		parse_error = "Invalid value list.";
+		return;
+	}
+	v = parse_value_signed();
+	if (v < -32768 || v > 32767)
+	{
+		parse_error = "Value out of 16-bit range.";
+		return;
+	}
+	if (parse_addr + parse_wcount > 64)
+	{
+		parse_error = "Too many values (past reg 64).";
+		return;
+	}
+
+	coeff_stage((int)(parse_addr + parse_wcount), (int16_t)v);
+	parse_wcount++;
+
+	// Ready for the next value in the list
+	parse_value = 0;
+	parse_value_digits = 0;
+	parse_value_neg = 0;
+}
+
+// ---------- Command execute handlers (run at end-of-line) ----------
+// Convention: handlers print their own success responses and set
+// parse_error for anything invalid; the caller prints the error.
+
+// Defined below the handlers; macro replay feeds recorded characters
+// back through the parser
+static void console_feed_char(char c);
+static void console_execute_line(void);
+
+// ========== COMMAND MACROS (record and replay on-target) ==========
+// Bring-up scripts replay the same sequences (baud, preset, commit,
+// verify, timer) over the wire every time, paying a round trip per
+// step. M<slot>{ records the following lines into a RAM slot instead of
+// executing them, } on its own line ends the recording, and M<slot>!
+// replays the slot at internal dispatch speed with a single summary
+// response - the individual command responses are swallowed.
+#define MACRO_SLOTS 4
+#define MACRO_BUF_SIZE 256
+
+static char macro_buf[MACRO_SLOTS][MACRO_BUF_SIZE];
+static uint16_t macro_len[MACRO_SLOTS];
+static uint8_t macro_recording = 0;  // Characters go to the slot, not the parser
+static uint8_t macro_record_slot = 0;
+static uint8_t macro_line_start = 1; // '}' only terminates at a line start
+static uint8_t macro_skip_eol = 0;   // Swallow the rest of the '}' line
+static uint8_t macro_replaying = 0;  // Guard against nested replay
+
+// Replay one recorded slot through the normal parser, suppressing the
+// per-command responses via the frame-capture redirect
+static void macro_replay(int slot)
+{
+	uint32_t commands_before = stat_commands;
+	uint16_t saved_resp_len = frame_resp_len;
+	uint8_t saved_capture = frame_capture;
+	uint8_t saved_active = frame_active;
+	uint8_t saved_stage = frame_stage;
+	uint32_t saved_seq = frame_seq;
+	uint16_t i;
+
+	macro_replaying = 1;
+	parser_reset();
+
+	frame_capture = 1;
+	for (i = 0; i < macro_len[slot]; i++)
+	{
+		char mc = macro_buf[slot][i];
+
+		if (mc == '\n')
+		{
+			console_execute_line();
+		}
+		else
+		{
+			console_feed_char(mc);
+		}
+	}
+	// A final line without newline still executes
+	if (parse_op != 0)
+	{
+		console_execute_line();
+	}
+	frame_capture = saved_capture;
+	frame_resp_len = saved_resp_len;
+	// The parser_reset above (and the one per replayed line) zeroed the
+	// frame state; restore it so a framed M<slot>! echoes the request's
+	// sequence number in its summary instead of #0
+	frame_active = saved_active;
+	frame_stage = saved_stage;
+	frame_seq = saved_seq;
+	macro_replaying = 0;
+
+	uart_puts("M:");
+	uart_put_int(slot);
+	uart_puts(" replayed ");
+	uart_put_int((int)(stat_commands - commands_before));
+	uart_puts(" commands\n");
+}
+
+// M<slot>{ / M<slot>! / M - record, replay or list macros
+static void cmd_macro(void)
+{
+	int slot = (int)parse_addr;
+
+	if (parse_brace)
+	{
+		if (!parse_addr_digits || slot >= MACRO_SLOTS)
+		{
+			parse_error = "Invalid macro slot (0-3).";
+			return;
+		}
+		if (macro_replaying)
+		{
+			parse_error = "Cannot record during replay.";
+			return;
+		}
+		macro_len[slot] = 0;
+		macro_record_slot = (uint8_t)slot;
+		macro_line_start = 1;
+		macro_recording = 1;
+		uart_puts("Recording macro ");
+		uart_put_int(slot);
+		uart_puts(" - end with }\n");
+	}
+	else if (parse_bang)
+	{
+		if (!parse_addr_digits || slot >= MACRO_SLOTS)
+		{
+			parse_error = "Invalid macro slot (0-3).";
+			return;
+		}
+		if (macro_replaying)
+		{
+			parse_error = "Nested replay not supported.";
+			return;
+		}
+		if (macro_len[slot] == 0)
+		{
+			parse_error = "Macro slot is empty.";
+			return;
+		}
+		macro_replay(slot);
+	}
+	else
+	{
+		int i;
+
+		for (i = 0; i < MACRO_SLOTS; i++)
+		{
+			uart_puts("Macro ");
+			uart_put_int(i);
+			uart_puts(": ");
+			uart_put_int((int)macro_len[i]);
+			uart_puts(" bytes\n");
+		}
+	}
+}
+
+// S<addr>$<value>
+static void cmd_set(void)
+{
+	int32_t v = parse_value_signed();
+
+	if (!parse_addr_digits || parse_addr > 64)
+	{
+		parse_error = "Address out of range (0-64).";
+		return;
+	}
+	if (parse_field != 1 || !parse_value_digits)
+	{
+		parse_error = "Invalid format. Use S<addr>$<value>";
+		return;
+	}
+	if (v < -32768 || v > 32767)
+	{
+		parse_error = "Invalid value (must be signed 16-bit: -32768 to 32767).";
+		return;
+	}
+
+	coeff_stage((int)parse_addr, (int16_t)v);
+	uart_puts("Staged reg[");
+	uart_put_int((int)parse_addr);
+	uart_puts("] = ");
+	uart_put_int((int)v);
+	uart_puts(" (C to commit)\n");
+}
+
+// W<start>$<v0>,<v1>,...
+static void cmd_bulk_write(void)
+{
+	if (parse_field != 1)
+	{
+		parse_error = "Invalid format. Use W<start>$<v0>,<v1>,...";
+		return;
+	}
+
+	// Values up to the last comma were staged as they arrived - finish
+	// the final one
+	parse_w_value_done();
+	if (parse_error != NULL)
+	{
+		return;
+	}
+
+	// One confirmation for the whole run instead of one per register
+	uart_puts("Staged ");
+	uart_put_int(parse_wcount);
+	uart_puts(" regs starting at ");
+	uart_put_int((int)parse_addr);
+	uart_puts(" (C to commit)\n");
+}
+
+// F<type>$<cutoff>[,<cutoff2>] - synthesize and commit a filter on-target
+static void cmd_synth(void)
+{
+	int16_t taps[FIR_SYNTH_TAPS];
+	int32_t c1;
+	int32_t c2;
+	uint8_t two_cutoffs;
+	int i;
+
+	if (parse_ftype_len != 2 ||
+	    !((parse_ftype[0] == 'L' && parse_ftype[1] == 'P') ||
+	      (parse_ftype[0] == 'H' && parse_ftype[1] == 'P') ||
+	      (parse_ftype[0] == 'B' && parse_ftype[1] == 'P') ||
+	      (parse_ftype[0] == 'B' && parse_ftype[1] == 'S')))
+	{
+		parse_error = "Invalid filter type (lp/hp/bp/bs).";
+		return;
+	}
+
+	two_cutoffs = (parse_ftype[0] == 'B');
+	if (parse_field != 1 || !parse_value_digits ||
+	    parse_cut1_set != two_cutoffs)
+	{
+		parse_error = "Invalid format. Use F<type>$<cutoff>[,<cutoff2>]";
+		return;
+	}
+
+	if (two_cutoffs)
+	{
+		c1 = parse_cut1;
+		c2 = parse_value_signed();
+	}
+	else
+	{
+		c1 = parse_value_signed();
+		c2 = 0;
+	}
+
+	if (c1 <= 0 || c1 >= FIR_SYNTH_FS / 2 ||
+	    (two_cutoffs && (c2 <= c1 || c2 >= FIR_SYNTH_FS / 2)))
+	{
+		parse_error = "Cutoff out of range (1-23999 Hz, cutoff1 < cutoff2).";
+		return;
+	}
+
+	fir_synth(parse_ftype, c1, c2, taps);
+	for (i = 0; i < FIR_SYNTH_TAPS; i++)
+	{
+		coeff_stage(i, taps[i]);
+	}
+	coeff_commit();
+
+	uart_puts("F:");
+	uart_putchar(parse_ftype[0]);
+	uart_putchar(parse_ftype[1]);
+	uart_puts(" fc=");
+	uart_put_int((int)c1);
+	if (two_cutoffs)
+	{
+		uart_putchar(',');
+		uart_put_int((int)c2);
+	}
+	uart_puts(" Hz - 64 taps committed\n");
+}
+
+// A[<n>] - capture n sample pairs (default: full buffer) and start the
+// background JTAG stream
+static void cmd_capture(void)
+{
+	int pairs = parse_addr_digits ? (int)parse_addr : CAPTURE_MAX_PAIRS;
+
+	if (pairs < 1 || pairs > CAPTURE_MAX_PAIRS)
+	{
+		parse_error = "Invalid pair count (1-256).";
+		return;
+	}
+	if (capture_streaming)
+	{
+		// A previous stream never drained (e.g. no JTAG reader attached
+		// and WSPACE stayed low) - abandon it rather than rejecting
+		// every A command until reset
+		capture_streaming = 0;
+		uart_puts("Abandoned stalled capture stream\n");
+	}
+
+	jtag_puts("CAP:START ");
+	jtag_put_int(pairs);
+	jtag_putchar('\n');
+	capture_run(pairs);
+
+	uart_puts("Captured ");
+	uart_put_int(pairs);
+	uart_puts(" sample pairs - streaming on JTAG\n");
+}
+
+// C - Commit the staged coefficient bank to hardware
+static void cmd_commit(void)
+{
+	coeff_commit();
+	uart_puts("Committed ");
+	uart_put_int(COEFF_REG_COUNT);
+	uart_puts(" regs\n");
+}
+
+// R<addr> from the RAM shadow, R!<addr> via the Avalon bus
+static void cmd_read(void)
+{
+	if (!parse_addr_digits || parse_addr > 64)
+	{
+		parse_error = "Address out of range (0-64).";
+		return;
+	}
+
+	if (parse_bang)
+	{
+		// Verification path: actually cross the Avalon fabric
+		uint32_t read_value = IORD_32DIRECT(MM_BRIDGE_0_BASE, parse_addr * 4);
+
+		uart_puts("Bus reg[");
+		uart_put_int((int)parse_addr);
+		uart_puts("] = ");
+		// Cast to int16_t first to get proper sign extension
+		uart_put_int((int)(int16_t)read_value);
+		uart_puts("\n");
+	}
+	else
+	{
+		uart_puts("Read reg[");
+		uart_put_int((int)parse_addr);
+		uart_puts("] = ");
+		uart_put_int((int)coeff_shadow[parse_addr]);
+		uart_puts("\n");
+	}
+}
+
+// D - One response line for all 65 registers, from the RAM shadow
+static void cmd_dump(void)
+{
+	int i;
+
+	uart_puts("D:");
+	for (i = 0; i < COEFF_REG_COUNT; i++)
+	{
+		if (i > 0)
+		{
+			uart_putchar(',');
+		}
+		uart_put_int((int)coeff_shadow[i]);
+	}
+	uart_puts("\n");
+}
+
+// V - CRC16 over all 65 registers, answered from the RAM shadow.
+// One sub-millisecond exchange replaces the 64-register readback the
+// host tooling used to run after every upload. CRC-CCITT (poly 0x1021,
+// init 0xFFFF), fed low byte first per register to match the
+// binary-mode wire order.
+static void cmd_verify(void)
+{
+	uint16_t crc = 0xFFFF;
+	int i;
+
+	for (i = 0; i < COEFF_REG_COUNT; i++)
+	{
+		uint16_t word = (uint16_t)coeff_shadow[i];
+		int half;
+
+		for (half = 0; half < 2; half++)
+		{
+			uint8_t byte = (half == 0) ? (uint8_t)word : (uint8_t)(word >> 8);
+			int bit;
+
+			crc ^= (uint16_t)byte << 8;
+			for (bit = 0; bit < 8; bit++)
+			{
+				if (crc & 0x8000)
+				{
+					crc = (uint16_t)((crc << 1) ^ 0x1021);
+				}
+				else
+				{
+					crc = (uint16_t)(crc << 1);
+				}
+			}
+		}
+	}
+
+	uart_puts("V:0x");
+	uart_put_hex16(crc);
+	uart_puts("\n");
+}
+
+// L / L<idx> / L<idx>! / L<idx>=<name> - preset store
+static void cmd_preset(void)
+{
+	int idx = (int)parse_addr;
+	int i;
+
+	if (!parse_addr_digits)
+	{
+		// Bare L lists all slots
+		for (i = 0; i < PRESET_COUNT; i++)
+		{
+			uart_puts("Preset ");
+			uart_put_int(i);
+			uart_puts(": ");
+			uart_puts(preset_names[i][0] ? preset_names[i] : "(empty)");
+			uart_puts("\n");
+		}
+		return;
+	}
+
+	if (idx >= PRESET_COUNT)
+	{
+		parse_error = "Invalid preset slot.";
+		return;
+	}
+
+	if (parse_name_mode)
+	{
+		// L<idx>=<name> - rename slot
+		memcpy(preset_names[idx], parse_name, parse_name_len);
+		preset_names[idx][parse_name_len] = '\0';
+		uart_puts("Renamed preset ");
+		uart_put_int(idx);
+		uart_puts("\n");
+	}
+	else if (parse_bang)
+	{
+		// L<idx>! - save staged bank into slot
+		preset_save(idx);
+		uart_puts("Saved staged bank to preset ");
+		uart_put_int(idx);
+		uart_puts("\n");
+	}
+	else
+	{
+		// L<idx> - load and commit
+		preset_load(idx);
+		uart_puts("Loaded preset ");
+		uart_put_int(idx);
+		uart_puts(" (");
+		uart_puts(preset_names[idx][0] ? preset_names[idx] : "unnamed");
+		uart_puts(")\n");
+	}
+}
+
+// N / N<addr> / NE / N! - watch mode subscriptions
+static void cmd_watch(void)
+{
+	if (parse_ftype_len)
+	{
+		// NE - toggle the error-counter group
+		if (parse_ftype_len != 1 || parse_ftype[0] != 'E')
+		{
+			parse_error = "Invalid watch group (only E).";
+			return;
+		}
+		watch_errors = !watch_errors;
+		if (watch_errors)
+		{
+			// Prime the baseline so only future changes notify
+			watch_err_last[0] = uart_parity_errors;
+			watch_err_last[1] = uart_frame_errors;
+			watch_err_last[2] = uart_overrun_errors;
+			watch_err_last[3] = uart_rx_dropped;
+			uart_puts("Watching error counters\n");
+		}
+		else
+		{
+			uart_puts("Error counters unwatched\n");
+		}
+	}
+	else if (parse_bang && !parse_addr_digits)
+	{
+		// N! - clear everything
+		memset(watch_mask, 0, sizeof(watch_mask));
+		watch_errors = 0;
+		uart_puts("All watches cleared\n");
+	}
+	else if (parse_addr_digits)
+	{
+		// N<addr> - toggle one register watch
+		int addr = (int)parse_addr;
+
+		if (addr >= WATCH_REG_COUNT)
+		{
+			parse_error = "Address out of range (0-255).";
+			return;
+		}
+		if (watch_mask[addr / 32] & (1u << (addr % 32)))
+		{
+			watch_mask[addr / 32] &= ~(1u << (addr % 32));
+			uart_puts("reg[");
+			uart_put_int(addr);
+			uart_puts("] unwatched\n");
+		}
+		else
+		{
+			watch_mask[addr / 32] |= 1u << (addr % 32);
+			// Prime from the bus so only future changes notify
+			watch_last[addr] =
+				(int16_t)IORD_32DIRECT(MM_BRIDGE_0_BASE, addr * 4);
+			uart_puts("Watching reg[");
+			uart_put_int(addr);
+			uart_puts("]\n");
+		}
+	}
+	else
+	{
+		// Bare N - list active watches
+		int addr;
+		int any = 0;
+
+		uart_puts("Watches:");
+		for (addr = 0; addr < WATCH_REG_COUNT; addr++)
+		{
+			if (watch_mask[addr / 32] & (1u << (addr % 32)))
+			{
+				uart_putchar(' ');
+				uart_put_int(addr);
+				any = 1;
+			}
+		}
+		if (watch_errors)
+		{
+			uart_puts(" ERR");
+			any = 1;
+		}
+		if (!any)
+		{
+			uart_puts(" (none)");
+		}
+		uart_puts("\n");
+	}
+}
+
+// P - Print profiling statistics (cycles) and reset them
+static void cmd_profile(void)
+{
+	prof_print("uart_isr", &prof_uart_isr);
+	prof_print("jtag_isr", &prof_jtag_isr);
+	prof_print("main_loop", &prof_main_loop);
+	prof_reset();
+}
+
+// I - Print the continuous performance counters
+static void cmd_counters(void)
+{
+	uart_puts("I:uart_isr=");
+	uart_put_int((int)stat_uart_isr_count);
+	uart_puts(" jtag_isr=");
+	uart_put_int((int)stat_jtag_isr_count);
+	uart_puts(" rx_bytes=");
+	uart_put_int((int)stat_rx_bytes);
+	uart_puts(" tx_bytes=");
+	uart_put_int((int)stat_tx_bytes);
+	uart_puts(" tx_rej=");
+	uart_put_int((int)stat_tx_rejected);
+	uart_puts(" tx_hwm=");
+	uart_put_int((int)stat_tx_high_water);
+	uart_puts(" rx_drop=");
+	uart_put_int((int)uart_rx_dropped);
+	uart_puts(" cmds=");
+	uart_put_int((int)stat_commands);
+	uart_puts("\n");
+}
+
+// X - Run the on-target micro-benchmarks
+static void cmd_benchmark(void)
+{
+	run_benchmark();
+}
+
+// B<baud> - Reconfigure the UART baud rate
+static void cmd_baud(void)
+{
+	if (!parse_addr_digits)
+	{
+		parse_error = "Invalid baud rate.";
+		return;
+	}
+	if (parse_addr < UART_MIN_BAUD || parse_addr > UART_MAX_BAUD)
+	{
+		parse_error = "Baud out of range (9600-921600).";
+		return;
+	}
+
+	// Confirm at the old rate, then switch
+	uart_puts("Switching to ");
+	uart_put_int((int)parse_addr);
+	uart_puts(" baud (send any char within 3s to confirm)\n");
+	uart_set_baud((uint32_t)parse_addr);
+
+	// Arm the fallback unless we switched back to the default anyway
+	if ((uint32_t)parse_addr != UART_DEFAULT_BAUD)
+	{
+		baud_probation = 1;
+		baud_probation_start = uptime_ms;
+	}
+}
+
+// J<level> - Set runtime log level (lab builds; cannot raise above the
+// compile-time ceiling)
+static void cmd_loglevel(void)
+{
+	if (!parse_addr_digits || parse_addr > LOG_LEVEL_TRACE)
+	{
+		parse_error = "Invalid log level (0=off 1=error 2=info 3=trace).";
+		return;
+	}
+
+	log_runtime_level = (uint8_t)parse_addr;
+	uart_puts("Log level set to ");
+	uart_put_int((int)parse_addr);
+	uart_puts("\n");
+}
+
+// T<interval> - Set PIO timer interval
+static void cmd_timer(void)
+{
+	if (!parse_addr_digits)
+	{
+		parse_error = "Invalid integer value.";
+		return;
+	}
+	if (parse_addr < 100 || parse_addr > 5000)
+	{
+		parse_error = "Value out of range (100-5000).";
+		return;
+	}
+
+	pio_toggle_interval = (uint32_t)parse_addr;
+	uart_puts("Timer interval set to: ");
+	uart_put_int((int)parse_addr);
+	uart_puts(" ms\n");
+}
+
+// Dispatch table indexed by opcode byte. A NULL entry (or a non-letter)
+// is an unknown command.
+typedef void (*console_cmd_fn)(void);
+static const console_cmd_fn console_cmd_table[26] = {
+	['A' - 'A'] = cmd_capture,
+	['B' - 'A'] = cmd_baud,
+	['C' - 'A'] = cmd_commit,
+	['D' - 'A'] = cmd_dump,
+	['F' - 'A'] = cmd_synth,
+	['I' - 'A'] = cmd_counters,
+	['J' - 'A'] = cmd_loglevel,
+	['L' - 'A'] = cmd_preset,
+	['M' - 'A'] = cmd_macro,
+	['N' - 'A'] = cmd_watch,
+	['P' - 'A'] = cmd_profile,
+	['R' - 'A'] = cmd_read,
+	['S' - 'A'] = cmd_set,
+	['T' - 'A'] = cmd_timer,
+	['V' - 'A'] = cmd_verify,
+	['W' - 'A'] = cmd_bulk_write,
+	['X' - 'A'] = cmd_benchmark,
+};
+
+// Feed one character into the incremental parser
+static void console_feed_char(char c)
+{
+	if (parse_op == 0)
+	{
+		// First character of the line selects the command
+		char op = (char)toupper((unsigned char)c);
+
+		if (op >= 'A' && op <= 'Z' && console_cmd_table[op - 'A'] != NULL)
+		{
+			parse_op = op;
+		}
+		else
+		{
+			parse_op = '?';
+			parse_unknown = 1;
+		}
+		return;
+	}
+
+	// Errors and unknown commands swallow the rest of the line
+	if (parse_unknown || parse_error != NULL)
+	{
+		return;
+	}
+
+	// Rename capture takes everything verbatim
+	if (parse_name_mode)
+	{
+		if (parse_name_len < PRESET_NAME_LEN - 1)
+		{
+			parse_name[parse_name_len++] = c;
+		}
+		return;
+	}
+
+	// F takes a two-letter filter type (lp/hp/bp/bs) before the '$';
+	// N takes a one-letter group name (NE)
+	if ((parse_op == 'F' || parse_op == 'N') &&
+	    parse_field == 0 && isalpha((unsigned char)c))
+	{
+		if (parse_ftype_len < 2)
+		{
+			parse_ftype[parse_ftype_len++] = (char)toupper((unsigned char)c);
+		}
+		else
+		{
+			parse_error = "Invalid filter type (lp/hp/bp/bs).";
+		}
+		return;
+	}
+
+	if (isdigit((unsigned char)c))
+	{
+		// Accumulate into the active numeric field, clamped so that no
+		// amount of digits can overflow 32 bits
+		if (parse_field == 0)
+		{
+			if (parse_addr < 10000000)
+			{
+				parse_addr = parse_addr * 10 + (c - '0');
+			}
+			parse_addr_digits++;
+		}
+		else
+		{
+			if (parse_value < 10000000)
+			{
+				parse_value = parse_value * 10 + (c - '0');
+			}
+			parse_value_digits++;
+		}
+		return;
+	}
+
+	switch (c)
+	{
+	case '$':
+		if ((parse_op == 'S' || parse_op == 'W' || parse_op == 'F') &&
+		    parse_field == 0)
+		{
+			parse_field = 1;
+		}
+		else
+		{
+			parse_error = "Unexpected '$'.";
+		}
+		break;
+
+	case ',':
+		if (parse_op == 'W' && parse_field == 1)
+		{
+			// Stage the completed value right away - zero re-scanning
+			parse_w_value_done();
+		}
+		else if (parse_op == 'F' && parse_field == 1 && !parse_cut1_set)
+		{
+			// First cutoff of a bp/bs design is complete
+			if (!parse_value_digits)
+			{
+				parse_error = "Invalid cutoff.";
+			}
+			else
+			{
+				parse_cut1 = parse_value_signed();
+				parse_cut1_set = 1;
+				parse_value = 0;
+				parse_value_digits = 0;
+				parse_value_neg = 0;
+			}
+		}
+		else
+		{
+			parse_error = "Unexpected ','.";
+		}
+		break;
+
+	case '-':
+	case '+':
+		if (parse_field == 1 && parse_value_digits == 0)
+		{
+			parse_value_neg = (c == '-');
+		}
+		else
+		{
+			parse_error = "Unexpected sign.";
+		}
+		break;
+
+	case '!':
+		if (parse_op == 'R' || parse_op == 'L' || parse_op == 'N' ||
+		    parse_op == 'M')
+		{
+			parse_bang = 1;
+		}
+		else
+		{
+			parse_error = "Unexpected '!'.";
+		}
+		break;
+
+	case '{':
+		if (parse_op == 'M' && parse_addr_digits)
+		{
+			parse_brace = 1;
+		}
+		else
+		{
+			parse_error = "Unexpected '{'.";
+		}
+		break;
+
+	case '=':
+		if (parse_op == 'L' && parse_addr_digits)
+		{
+			parse_name_mode = 1;
+		}
+		else
+		{
+			parse_error = "Unexpected '='.";
+		}
+		break;
+
+	case ' ':
+	case '\t':
+		// Whitespace is ignored everywhere
+		break;
+
+	default:
+		parse_error = "Invalid character in command.";
+		break;
+	}
+}
+
+// Execute the line accumulated in the parser state. Shared between the
+// interactive end-of-line path and macro replay; the caller resets the
+// parser (interactive) or this function does (replay, one line each).
+static void console_execute_line(void)
+{
+	if (parse_op != 0)
+	{
+		stat_commands++;
+
+		if (parse_unknown)
+		{
+			uart_puts("Unknown command. Use S, W, F, C, L, M, R, D, V, A, N, P, X, I, B, J or T\n");
+		}
+		else
+		{
+			if (parse_error == NULL)
+			{
+				console_cmd_table[parse_op - 'A']();
+			}
+			if (parse_error != NULL)
+			{
+				uart_puts(parse_error);
+				uart_puts("\n");
+			}
+		}
+	}
+
+	parser_reset();
+}
+
+// ---------- CRC-framed protocol variant ----------
+
+// CRC8, polynomial 0x07, init 0x00, MSB first
+static uint8_t crc8_update(uint8_t crc, uint8_t byte)
+{
+	int bit;
+
+	crc ^= byte;
+	for (bit = 0; bit < 8; bit++)
+	{
+		if (crc & 0x80)
+		{
+			crc = (uint8_t)((crc << 1) ^ 0x07);
+		}
+		else
+		{
+			crc = (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+// Feed one character of a framed line (everything after the '#')
+static void frame_feed_char(char c)
+{
+	switch (frame_stage)
+	{
+	case 0:
+		// Sequence number digits, terminated by ':'
+		frame_crc_calc = crc8_update(frame_crc_calc, (uint8_t)c);
+		if (isdigit((unsigned char)c))
+		{
+			frame_seq = frame_seq * 10 + (uint32_t)(c - '0');
+			frame_seq_digits++;
+			if (frame_seq > 255)
+			{
+				frame_bad = 1;
+			}
+		}
+		else if (c == ':' && frame_seq_digits)
+		{
+			frame_stage = 1;
+		}
+		else
+		{
+			frame_bad = 1;
+		}
+		break;
+
+	case 1:
+		// Command body - runs through the normal incremental parser,
+		// CRC'd on the way in. '*' ends the body.
+		if (c == '*')
+		{
+			frame_stage = 2;
+			break;
+		}
+		frame_crc_calc = crc8_update(frame_crc_calc, (uint8_t)c);
+		console_feed_char(c);
+		break;
+
+	default:
+	{
+		// Exactly two hex CRC digits
+		int nibble = -1;
+
+		if (c >= '0' && c <= '9')
+		{
+			nibble = c - '0';
+		}
+		else if (c >= 'A' && c <= 'F')
+		{
+			nibble = c - 'A' + 10;
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			nibble = c - 'a' + 10;
+		}
+
+		if (nibble < 0 || frame_crc_digits >= 2)
+		{
+			frame_bad = 1;
+			break;
+		}
+		frame_crc_rx = (uint8_t)((frame_crc_rx << 4) | nibble);
+		frame_crc_digits++;
+		break;
+	}
+	}
+}
+
+// Send one framed response: #<seq>:<body>*<crc8>
+static void frame_send(const char *body, uint16_t len)
+{
+	static const char hex_digits[16] = "0123456789ABCDEF";
+	char seq_buf[12];
+	char tail[3];
+	int seq_len = format_int((int)frame_seq, seq_buf);
+	uint8_t crc = 0;
+	int i;
+
+	// Response CRC covers "<seq>:<body>", same rule as the request
+	for (i = 0; i < seq_len; i++)
+	{
+		crc = crc8_update(crc, (uint8_t)seq_buf[i]);
+	}
+	crc = crc8_update(crc, ':');
+	for (i = 0; i < len; i++)
+	{
+		crc = crc8_update(crc, (uint8_t)body[i]);
+	}
+
+	uart_putchar('#');
+	uart_write(seq_buf, (uint16_t)seq_len);
+	uart_putchar(':');
+	uart_write(body, len);
+	tail[0] = '*';
+	tail[1] = hex_digits[crc >> 4];
+	tail[2] = hex_digits[crc & 0xF];
+	uart_write(tail, 3);
+	uart_puts("\n");
+}
+
+// End-of-line handling for a framed line: verify and execute, or NAK
+// right away so the host retransmits instead of waiting out a timeout
+static void frame_execute(void)
+{
+	if (frame_bad || frame_stage != 2 || frame_crc_digits != 2 ||
+	    frame_crc_rx != frame_crc_calc || parse_op == 0 || parse_unknown)
+	{
+		frame_send("NAK", 3);
+		return;
+	}
+
+	stat_commands++;
+
+	// Run the handler with its output captured into the frame buffer
+	frame_resp_len = 0;
+	frame_capture = 1;
+	if (parse_error == NULL)
+	{
+		console_cmd_table[parse_op - 'A']();
+	}
+	if (parse_error != NULL)
+	{
+		uart_puts(parse_error);
+	}
+	frame_capture = 0;
+
+	// Strip the trailing newline - the frame tail ends the response
+	while (frame_resp_len > 0 &&
+	       (frame_resp[frame_resp_len - 1] == '\n' ||
+	        frame_resp[frame_resp_len - 1] == '\r'))
+	{
+		frame_resp_len--;
+	}
+
+	frame_send(frame_resp, frame_resp_len);
+}
+
+// ========== DEFERRED STARTUP BANNER ==========
+// Fast boot: the ~700-character banner is not queued at startup (it
+// would serialize through the TX ring before the system is responsive)
+// but on the first character received from the host. Automated hosts
+// that open with ESC (binary mode) or '#' (framed protocol) never get
+// it at all.
+static uint8_t banner_pending = 1;
+
+static void print_banner(void)
+{
+	// The full banner is ~1250 bytes on the wire after CRLF expansion -
+	// more than the 512-byte TX ring holds. Drain the ring between
+	// sections so no line is silently dropped by the non-blocking writes.
+	uart_puts("\n\n*** FIR FPGA Console ***\n");
+	uart_puts("RS232 UART: 115200 baud, 8N1\n");
+	uart_puts("Commands:\n");
+	uart_puts("  S<addr>$<value> - Stage register (addr: 0-64, value: signed 16-bit)\n");
+	uart_puts("  W<start>$<v0>,<v1>,... - Stage values for consecutive registers\n");
+	uart_puts("  F<type>$<fc>[,<fc2>] - Synthesize filter (lp/hp/bp/bs, Hz)\n");
+	uart_flush();
+	uart_puts("  C               - Commit staged coefficients to hardware\n");
+	uart_puts("  L[<idx>[!|=<name>]] - Preset store: list/load/save/rename\n");
+	uart_puts("  M<slot>{ / M<slot>! - Record macro (end with }) / replay it\n");
+	uart_puts("  R<addr>         - Read register (addr: 0-64, R!<addr> = bus read)\n");
+	uart_puts("  D               - Dump all registers as one line\n");
+	uart_puts("  V               - CRC16 over all registers (verification)\n");
+	uart_flush();
+	uart_puts("  A[<n>]          - Capture sample pairs, stream on JTAG\n");
+	uart_puts("  N[<addr>|E|!]   - Watch registers/counters (push on change)\n");
+	uart_puts("  P               - Profiling stats (cycles), then reset\n");
+	uart_puts("  X               - Micro-benchmarks (bus, TX ring, wire)\n");
+	uart_puts("  I               - Performance counters\n");
+	uart_puts("  B<baud>         - Set baud rate (9600-921600)\n");
+	uart_flush();
+	uart_puts("  J<level>        - Set JTAG log level (0=off..3=trace)\n");
+	uart_puts("  T<interval>     - Set timer interval in ms (100-5000)\n");
+	uart_puts("  #<seq>:<cmd>*<crc8> - CRC-framed command (immediate NAK)\n");
+	uart_puts("  ESC B           - Enter binary command mode (framed, no echo)\n");
+	uart_puts("\nCurrent timer interval: ");
+	uart_put_int((int)pio_toggle_interval);
+	uart_puts(" ms\n");
+	uart_puts("Ready> ");
+}
+
+// Process console input for commands using interrupt-driven input
+// Commands:
+//   S<addr>$<value>     - Stage register at address (0-64) with signed 16-bit value
+//   W<start>$<v0>,<v1>,... - Stage values for consecutive registers
+//   F<type>$<fc>[,<fc2>] - Synthesize lp/hp/bp/bs filter on-target and commit
+//   C                   - Commit the staged coefficient bank to hardware
+//   L[<idx>[!|=<name>]] - Preset store: list / load / save / rename slots
+//   M<slot>{ ... }      - Record the following lines into a macro slot (0-3)
+//   M<slot>!            - Replay a recorded macro with one summary response
+//   R<addr>             - Read register at address (0-64) from the RAM shadow
+//   R!<addr>            - Read register via the Avalon bus (verification)
+//   D                   - Dump all 65 registers as one compact line
+//   V                   - CRC16 over all 65 registers (upload verification)
+//   A[<n>]              - Capture FIR sample pairs, background-stream on JTAG
+//   N[<addr>|E|!]       - Watch registers/counters, push lines on change
+//   P                   - Print profiling statistics and reset them
+//   X                   - Run on-target micro-benchmarks
+//   I                   - Print continuous performance counters
+//   B<baud>             - Set UART baud rate (fallback to 115200 on silence)
+//   J<level>            - Set runtime JTAG log level (0=off..3=trace)
+//   T<interval>         - Set PIO timer interval
+//   #<seq>:<cmd>*<crc8> - CRC-framed variant of any command (NAK on error)
+//   ESC B               - Switch to binary command mode (no echo, framed)
+void process_console_input(void)
+{
+	char c;
+
+	// Drain everything waiting in the RX ring in one pass, so the host
+	// can stream newline-separated commands back-to-back without pacing
+	// delays - command throughput is no longer gated by the main-loop
+	// frequency
+	while (uart_rx_available())
+	{
+		c = uart_rx_getchar();
+
+		// Any received character confirms a recent baud-rate switch
+		baud_probation = 0;
+
+		// First contact after fast boot: print the deferred banner,
+		// unless the host opens with a machine protocol
+		if (banner_pending)
+		{
+			banner_pending = 0;
+			if (c != 0x1B && c != '#')
+			{
+				print_banner();
+			}
+		}
+
+		// Binary mode consumes raw bytes without echo
+		if (binary_mode)
+		{
+			binary_mode_input((uint8_t)c);
+			continue;
+		}
+
+		// ESC starts a mode-switch sequence (not echoed, not buffered)
+		if (escape_pending)
+		{
+			escape_pending = 0;
+			if (c == 'B' || c == 'b')
+			{
+				binary_mode = 1;
+				continue;
+			}
+			// Unknown escape sequence - swallow it and fall through to
+			// normal handling of the current character
+		}
+		else if (c == 0x1B)
+		{
+			escape_pending = 1;
+			continue;
+		}
+
+		// The rest of the '}' line that ended a macro recording is
+		// discarded
+		if (macro_skip_eol)
+		{
+			if (c == '\r' || c == '\n')
+			{
+				macro_skip_eol = 0;
+			}
+			continue;
+		}
+
+		// While recording, characters go into the macro slot verbatim
+		// instead of the parser; '}' at the start of a line ends it
+		if (macro_recording)
+		{
+			if (macro_line_start && c == '}')
+			{
+				macro_recording = 0;
+				macro_skip_eol = 1;
+				uart_puts("}\nMacro ");
+				uart_put_int((int)macro_record_slot);
+				uart_puts(" recorded (");
+				uart_put_int((int)macro_len[macro_record_slot]);
+				uart_puts(" bytes)\n");
+			}
+			else if (c == '\r' || c == '\n')
+			{
+				uart_puts("\n");
+				if (macro_len[macro_record_slot] < MACRO_BUF_SIZE)
+				{
+					macro_buf[macro_record_slot][macro_len[macro_record_slot]++] = '\n';
+				}
+				macro_line_start = 1;
+			}
+			else if (macro_len[macro_record_slot] < MACRO_BUF_SIZE)
+			{
+				uart_putchar(c);
+				macro_buf[macro_record_slot][macro_len[macro_record_slot]++] = c;
+				macro_line_start = 0;
+			}
+			else
+			{
+				// Slot full - abort rather than replay a truncated line
+				macro_recording = 0;
+				macro_skip_eol = 1;
+				macro_len[macro_record_slot] = 0;
+				uart_puts("\nMacro buffer full - recording aborted\n");
+			}
+			continue;
+		}
+
+		// A '#' opening the line selects the CRC-framed protocol
+		// variant - host-driven, so nothing is echoed
+		if (!frame_active && parse_op == 0 && c == '#')
+		{
+			frame_active = 1;
+			continue;
+		}
+
+		if (frame_active)
+		{
+			if (c == '\r' || c == '\n')
+			{
+				frame_execute();
+				parser_reset();
+			}
+			else
+			{
+				frame_feed_char(c);
+			}
+			continue;
+		}
+
+		// Handle Enter key: the fields are already parsed, so the
+		// command executes immediately
+		if (c == '\r' || c == '\n')
+		{
+			// Echo newline
+			uart_puts("\n");
+			console_execute_line();
+		}
+		else
+		{
+			// Echo the character and parse it incrementally
+			uart_putchar(c);
+			console_feed_char(c);
+		}
+	}
+}
+
+int main()
+{
+	uint8_t pio_state = 0;
+	uint32_t debug_counter = 0; // Counter for periodic debug messages
+	uint32_t boot_ready_cycles;
+
+	// ===== FAST BOOT: FILTER ACTIVE FIRST =====
+	// Everything the power-cycle-on-fault recovery cares about happens
+	// before any console or debug traffic: load the coefficients, raise
+	// the PIO readiness bit, take the time. The banner is deferred until
+	// the host sends its first character (see print_banner).
+
+	// Timer is configured to run continuously with period of 1ms
+	// (configured in Qsys as TIMER_0_PERIOD = 1ms)
+
+	// Configure the control register:
+	// - Enable continuous mode (CONT bit)
+	// - Start the timer (START bit)
+	// No ITO: the timer is read by snapshot polling only, it never
+	// interrupts (see the polled timebase section)
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER_0_BASE,
+		ALTERA_AVALON_TIMER_CONTROL_CONT_MSK |
+		ALTERA_AVALON_TIMER_CONTROL_START_MSK);
+
+	// Anchor the polled millisecond timebase at the current count
+	timebase_last_snap = prof_snapshot_atomic();
+
+	// Preload FIR coefficients: seed preset slot 0 with the built-in
+	// filter and load it through the staged bank
+	memcpy(preset_store[0], fir_coefficients, sizeof(fir_coefficients));
+	strcpy(preset_names[0], "500Hz_LP");
+	// Register 64 is not part of the coefficient preload - take over its
+	// hardware reset value so a commit does not change it
+	coeff_stage(64, (int16_t)IORD_32DIRECT(MM_BRIDGE_0_BASE, 64 * 4));
+	preset_load(0);
+
+	// Filter is live - signal readiness on the PIO right away
+	pio_state = 0x01;
+	IOWR_ALTERA_AVALON_PIO_DATA(PIO_0_BASE, pio_state);
+	boot_ready_cycles = bench_cycles_now();
 
 	// ===== JTAG UART INITIALIZATION (Debug Messages) =====
 	// Register JTAG UART interrupt handler
@@ -601,23 +2932,18 @@ int main()
 	control |= ALTERA_AVALON_JTAG_UART_CONTROL_RE_MSK; // Enable read interrupt
 	IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_0_BASE, control);
 
-	// Send debug message to JTAG UART
-	jtag_puts("\n=== DEBUG: System Starting ===\n");
-
-	// Timer is configured to run continuously with period of 1ms
-	// (configured in Qsys as TIMER_0_PERIOD = 1ms)
-
-	// Configure the control register: 
-	// - Enable interrupts (ITO bit)
-	// - Enable continuous mode (CONT bit)
-	// - Start the timer (START bit)
-	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER_0_BASE, 
-		ALTERA_AVALON_TIMER_CONTROL_ITO_MSK |
-		ALTERA_AVALON_TIMER_CONTROL_CONT_MSK |
-		ALTERA_AVALON_TIMER_CONTROL_START_MSK);
+	// Report the measured boot-to-ready time on the debug channel
+	LOG_PUTS(LOG_LEVEL_INFO, "\n=== DEBUG: System Starting ===\n");
+	LOG_PUTS(LOG_LEVEL_INFO, "DEBUG: boot-to-ready ");
+	LOG_PUT_INT(LOG_LEVEL_INFO, (int)timer_tick_count);
+	LOG_PUTS(LOG_LEVEL_INFO, " ticks (");
+	LOG_PUT_INT(LOG_LEVEL_INFO, (int)boot_ready_cycles);
+	LOG_PUTS(LOG_LEVEL_INFO, " cycles)\n");
 
 	// ===== RS232 UART INITIALIZATION (User Interface) =====
-	// Initialize TX buffer (head = tail = 0, buffer empty)
+	// Initialize RX and TX buffers (head = tail = 0, buffers empty)
+	rx_head = 0;
+	rx_tail = 0;
 	tx_head = 0;
 	tx_tail = 0;
 
@@ -637,38 +2963,71 @@ int main()
 	IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, ALTERA_AVALON_UART_CONTROL_RRDY_MSK);
 
 	// Send debug message to JTAG UART
-	jtag_puts("DEBUG: UART initialized - 115200 8N1\n");
-	
-	// Preload FIR coefficients into MM bridge registers
-	jtag_puts("DEBUG: Preloading FIR coefficients...\n");
-	for (int i = 0; i < 64; i++)
-	{
-		IOWR_32DIRECT(MM_BRIDGE_0_BASE, i * 4, (uint32_t)fir_coefficients[i]);
-	}
-	jtag_puts("DEBUG: FIR coefficients loaded\n");
+	LOG_PUTS(LOG_LEVEL_INFO, "DEBUG: UART initialized - 115200 8N1\n");
 
-	// ===== USER INTERFACE via RS232 UART =====
-	uart_puts("\n\n*** FIR FPGA Console ***\n");
-	uart_puts("RS232 UART: 115200 baud, 8N1\n");
-	uart_puts("Commands:\n");
-	uart_puts("  S<addr>$<value> - Set register (addr: 0-64, value: signed 16-bit)\n");
-	uart_puts("  R<addr>         - Read register (addr: 0-64)\n");
-	uart_puts("  T<interval>     - Set timer interval in ms (100-5000)\n");
-	uart_puts("\nCurrent timer interval: ");
-	uart_put_int((int)delay_value);
-	uart_puts(" ms\n");
-	uart_puts("Ready> ");
+	// The banner is deferred to the first received character -
+	// print_banner() runs from process_console_input()
+	LOG_PUTS(LOG_LEVEL_INFO, "DEBUG: System ready, entering main loop\n");
 
-	// Send debug info to JTAG UART
-	jtag_puts("DEBUG: System ready, entering main loop\n");
+	// Profiling: measure the time between main-loop wakeups
+	uint32_t prof_prev_snap = prof_snapshot_atomic();
 
 	while (1)
 	{
-		// Check for console input (processed via UART interrupt)
-		process_console_input(&delay_value);
+		uint8_t events;
+		alt_irq_context irq_context;
+
+		// Idle until an event is posted - EVENT_RX by the ISRs, EVENT_TICK
+		// by the timebase poll itself once a millisecond has accumulated.
+		// A received byte still wakes straight into the parser with
+		// bounded latency (Nios II/e has no true sleep instruction)
+		while (event_pending == 0)
+		{
+			timebase_poll();
+		}
+
+		// Snapshot and clear the event word atomically; an event posted
+		// right after the clear just causes one extra wakeup
+		irq_context = alt_irq_disable_all();
+		events = event_pending;
+		event_pending = 0;
+		alt_irq_enable_all(irq_context);
+
+		// Record the time since the previous wakeup
+		uint32_t prof_now = prof_snapshot_atomic();
+		prof_record(&prof_main_loop, prof_elapsed(prof_prev_snap, prof_now));
+		prof_prev_snap = prof_now;
+
+		// Console input arrived (via UART or JTAG interrupt)
+		if (events & EVENT_RX)
+		{
+			process_console_input();
+		}
+
+		// Background-stream an armed capture over the JTAG channel
+		if (capture_streaming)
+		{
+			capture_stream_step();
+		}
+
+		// Everything below is paced by the timer tick
+		if ((events & EVENT_TICK) == 0)
+		{
+			continue;
+		}
+
+		// Baud-rate fallback: if the host never re-established contact
+		// after a B command, drop back to the default rate
+		if (baud_probation &&
+		    (uptime_ms - baud_probation_start) >= BAUD_FALLBACK_TIMEOUT_MS)
+		{
+			baud_probation = 0;
+			uart_set_baud(UART_DEFAULT_BAUD);
+			LOG_PUTS(LOG_LEVEL_ERROR, "DEBUG: no host contact, baud fallback to 115200\n");
+		}
 
 		// Check if enough timer ticks have elapsed
-		if (timer_tick_count  >= delay_value)
+		if (timer_tick_count  >= pio_toggle_interval)
 		{
 			timer_tick_count = 0;
 
@@ -676,20 +3035,33 @@ int main()
 			pio_state ^= 0x01;
 			IOWR_ALTERA_AVALON_PIO_DATA(PIO_0_BASE, pio_state);
 
-			// Send periodic debug info to JTAG UART (every 10 toggles)
+			// Push notifications for watched registers and counters
+			watch_check();
+
+			// Send periodic debug info to JTAG UART (every 10 toggles).
+			// Guarded as one TRACE block so a production build compiles
+			// the whole dump away
 			debug_counter++;
 			if (debug_counter >= 10)
 			{
 				debug_counter = 0;
 
-				// Debug info to JTAG UART only
-				jtag_puts("DEBUG: PIO toggling, errors: PE=");
-				jtag_put_int(uart_parity_errors);
-				jtag_puts(" FE=");
-				jtag_put_int(uart_frame_errors);
-				jtag_puts(" OE=");
-				jtag_put_int(uart_overrun_errors);
-				jtag_puts("\n");
+				if (LOG_ENABLED(LOG_LEVEL_TRACE))
+				{
+					jtag_puts("DEBUG: PIO toggling, errors: PE=");
+					jtag_put_int(uart_parity_errors);
+					jtag_puts(" FE=");
+					jtag_put_int(uart_frame_errors);
+					jtag_puts(" OE=");
+					jtag_put_int(uart_overrun_errors);
+					jtag_puts(" RXDROP=");
+					jtag_put_int(uart_rx_dropped);
+					jtag_puts(" TXHWM=");
+					jtag_put_int(stat_tx_high_water);
+					jtag_puts(" CMDS=");
+					jtag_put_int(stat_commands);
+					jtag_puts("\n");
+				}
 			}
 		}
 	}